@@ -0,0 +1,175 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_ATOM_H_INCLUDED
+#define ES_ATOM_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "one_at_a_time.hpp"
+
+// Atom is a handle to a string interned in the process-wide atom table.
+// Two atoms are equal if and only if their strings are equal, so atoms can
+// be compared and hashed as integers. The hash of an atom is the same as
+// one_at_a_time::hash() of its string, so it can be used in a switch
+// statement with constexpr Intern() values. An interned string is removed
+// from the table when the last atom referring to it is destroyed, so that
+// the ids and the class names of the elements, which can be any strings,
+// do not stay in the table forever.
+class Atom
+{
+    struct Entry
+    {
+        std::u16string string;
+        std::uint32_t hash;
+        std::atomic_uint count;
+
+        Entry(const std::u16string& string, std::uint32_t hash) :
+            string(string),
+            hash(hash),
+            count(1)
+        {}
+    };
+
+    class Table
+    {
+        std::mutex mutex;
+        std::unordered_map<std::u16string, Entry*> map;
+    public:
+        const Entry* find(const std::u16string& s, bool add) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = map.find(s);
+            if (found != map.end()) {
+                found->second->count.fetch_add(1, std::memory_order_relaxed);
+                return found->second;
+            }
+            if (!add)
+                return 0;
+            Entry* entry = new Entry(s, computeHash(s));
+            map.insert(std::make_pair(s, entry));
+            return entry;
+        }
+        void release(const Entry* e) {
+            Entry* entry = const_cast<Entry*>(e);
+            // The count drops to zero only while the table is locked so
+            // that find() cannot pick up the entry being removed.
+            unsigned count = entry->count.load(std::memory_order_relaxed);
+            while (1 < count) {
+                if (entry->count.compare_exchange_weak(count, count - 1, std::memory_order_release, std::memory_order_relaxed))
+                    return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (entry->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                map.erase(entry->string);
+                delete entry;
+            }
+        }
+    };
+
+    const Entry* entry;
+
+    // The table is never destroyed so that atoms stay valid while other
+    // static objects are being destroyed.
+    static Table& getTable() {
+        static Table* table = new Table;
+        return *table;
+    }
+
+    explicit Atom(const Entry* entry) :
+        entry(entry)
+    {}
+
+public:
+    static std::uint32_t computeHash(const std::u16string& s) {
+        std::uint32_t hash = 0;
+        for (auto i = s.begin(); i != s.end(); ++i)
+            hash = one_at_a_time::mix(hash + *i);
+        return one_at_a_time::postprocess(hash);
+    }
+
+    // Returns the atom for s if s is currently interned, or the null atom
+    // otherwise; useful for lookups that cannot match a new string.
+    static Atom find(const std::u16string& s) {
+        return Atom(getTable().find(s, false));
+    }
+
+    Atom() :
+        entry(0)
+    {}
+    explicit Atom(const std::u16string& s) :
+        entry(getTable().find(s, true))
+    {}
+    Atom(const Atom& atom) :
+        entry(atom.entry)
+    {
+        if (entry)
+            const_cast<Entry*>(entry)->count.fetch_add(1, std::memory_order_relaxed);
+    }
+    Atom(Atom&& atom) :
+        entry(atom.entry)
+    {
+        atom.entry = 0;
+    }
+    ~Atom() {
+        if (entry)
+            getTable().release(entry);
+    }
+    Atom& operator=(Atom atom) {
+        std::swap(entry, atom.entry);
+        return *this;
+    }
+
+    const std::u16string& toString() const {
+        static const std::u16string empty;
+        return entry ? entry->string : empty;
+    }
+    std::uint32_t getHash() const {
+        return entry ? entry->hash : 0;
+    }
+
+    explicit operator bool() const {
+        return entry;
+    }
+    bool operator==(const Atom& atom) const {
+        return entry == atom.entry;
+    }
+    bool operator!=(const Atom& atom) const {
+        return entry != atom.entry;
+    }
+    bool operator<(const Atom& atom) const {
+        return entry < atom.entry;
+    }
+};
+
+namespace std {
+
+template<>
+struct hash<Atom>
+{
+    size_t operator()(const Atom& atom) const {
+        return atom.getHash();
+    }
+};
+
+}
+
+#endif  // ES_ATOM_H_INCLUDED
@@ -18,6 +18,8 @@
 
 #include <Object.h>
 
+#include "ElementImp.h"
+
 #include <new>
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
@@ -35,14 +37,14 @@ Nullable<std::u16string> AttrImp::getPrefix()
 
 std::u16string AttrImp::getLocalName()
 {
-    return localName;
+    return localName.toString();
 }
 
 std::u16string AttrImp::getName()
 {
     if (prefix.hasValue())
-        return prefix.value() + u":" + localName;
-    return localName;
+        return prefix.value() + u":" + localName.toString();
+    return localName.toString();
 }
 
 std::u16string AttrImp::getValue()
@@ -53,13 +55,17 @@ std::u16string AttrImp::getValue()
 void AttrImp::setValue(const std::u16string& value)
 {
     this->value = value;
+    // Keep the id and class attributes cached by the owner element current.
+    if (ownerElement && !prefix.hasValue() && static_cast<std::u16string>(namespaceURI).empty())
+        ownerElement->updateAttributeCache(localName.toString(), value);
 }
 
-AttrImp::AttrImp(Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName, const std::u16string& value) :
+AttrImp::AttrImp(Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName, const std::u16string& value, ElementImp* ownerElement) :
     namespaceURI(namespaceURI),
     prefix(prefix),
     localName(localName),
-    value(value)
+    value(value),
+    ownerElement(ownerElement)
 {
 }
 
@@ -23,18 +23,40 @@
 
 #include <org/w3c/dom/Attr.h>
 
+#include "Atom.h"
+
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+class ElementImp;
+
 class AttrImp : public ObjectMixin<AttrImp>
 {
 private:
     Nullable<std::u16string> namespaceURI;
     Nullable<std::u16string> prefix;
-    std::u16string localName;
+    Atom localName;
     std::u16string value;
+    ElementImp* ownerElement;   // cleared when this attribute is removed from the element
 
 public:
-    AttrImp(Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName, const std::u16string& value);
+    AttrImp(Nullable<std::u16string> namespaceURI, Nullable<std::u16string> prefix, const std::u16string& localName, const std::u16string& value, ElementImp* ownerElement = nullptr);
+
+    void clearOwnerElement() {
+        ownerElement = nullptr;
+    }
+
+    // Returns true if the qualified name of this attribute is name. The name
+    // is compared as a string so that no atom has to be looked up.
+    bool hasName(const std::u16string& name) const {
+        const std::u16string& local(localName.toString());
+        if (!prefix.hasValue())
+            return local == name;
+        const std::u16string& p(prefix.value());
+        return name.length() == p.length() + 1 + local.length() &&
+               name.compare(0, p.length(), p) == 0 &&
+               name[p.length()] == u':' &&
+               name.compare(p.length() + 1, local.length(), local) == 0;
+    }
 
     // Attr
     virtual Nullable<std::u16string> getNamespaceURI();
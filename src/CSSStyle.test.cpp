@@ -18,11 +18,16 @@
 #include "css/CSSInputStream.h"
 
 #include <assert.h>
+#include <stdlib.h>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <set>
 #include <sstream>
+#include <thread>
 
 #include <org/w3c/dom/css/CSSMediaRule.h>
 #include <org/w3c/dom/css/CSSStyleRule.h>
@@ -97,11 +102,111 @@ const char* htmlDocument =
     "</body>"
     "</html>";
 
+size_t allocationCount = 0;
+
+// An allocator that counts the allocations made by the matched rule sets.
+template<class T>
+struct CountingAllocator : public std::allocator<T>
+{
+    template<class U>
+    struct rebind {
+        typedef CountingAllocator<U> other;
+    };
+
+    CountingAllocator() {}
+    template<class U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n, const void* hint = 0) {
+        ++allocationCount;
+        return std::allocator<T>::allocate(n);
+    }
+};
+
+typedef CSSRuleListImp::BasicRuleSet<CountingAllocator<CSSRuleListImp::PrioritizedRule>> CountingRuleSet;
+typedef std::multiset<CSSRuleListImp::PrioritizedRule, std::less<CSSRuleListImp::PrioritizedRule>,
+                      CountingAllocator<CSSRuleListImp::PrioritizedRule>> CountingMultiset;
+
+// The rules of the same priority must be iterated in the insertion order as
+// in std::multiset, or the cascade would pick a different declaration. The
+// declarations are used only to tell the rules apart.
+void testRuleSet()
+{
+    const unsigned Rules = 24;
+
+    char declarations[Rules];
+    CSSRuleListImp::RuleSet set;
+    std::multiset<CSSRuleListImp::PrioritizedRule> expected;
+    for (unsigned r = 0; r < Rules; ++r) {
+        CSSRuleListImp::PrioritizedRule rule(CSSRuleListImp::Author | (r * 7 % 4), reinterpret_cast<CSSStyleDeclarationImp*>(declarations + r));
+        set.insert(rule);
+        expected.insert(rule);
+    }
+    assert(set.size() == expected.size());
+    assert(std::equal(set.begin(), set.end(), expected.begin(),
+                      [](const CSSRuleListImp::PrioritizedRule& a, const CSSRuleListImp::PrioritizedRule& b) {
+                          return a.getDeclaration() == b.getDeclaration();
+                      }));
+}
+
+// Compares the allocations made for the matched rules by RuleSet and by
+// std::multiset.
+template<class SET>
+void benchmarkRuleSet(const char* name)
+{
+    const unsigned Elements = 10000;
+    const unsigned Rules = 24;    // matched rules per element
+
+    size_t count = allocationCount;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned e = 0; e < Elements; ++e) {
+        SET set;
+        for (unsigned r = 0; r < Rules; ++r)
+            set.insert(CSSRuleListImp::PrioritizedRule(CSSRuleListImp::Author | (r * 7 % Rules), nullptr));
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << name << ": " << (allocationCount - count) << " allocations, " <<
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " usec\n";
+}
+
+// Measures the selector matching of the page at path with an increasing
+// number of matching threads.
+int benchmark(const char* path)
+{
+    std::ifstream stream(path);
+    if (!stream) {
+        std::cerr << "error: cannot open " << path << ".\n";
+        return EXIT_FAILURE;
+    }
+    Document document = loadDocument(stream);
+    assert(document);
+
+    benchmarkRuleSet<CountingRuleSet>("RuleSet");
+    benchmarkRuleSet<CountingMultiset>("std::multiset");
+
+    unsigned max = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned count = 1; count <= max; count *= 2) {
+        ViewCSSImp::setMatchingThreads(count);
+        WindowPtr window = std::make_shared<WindowImp>();
+        window->setDocument(std::static_pointer_cast<bootstrap::DocumentImp>(document.self()));
+        auto start = std::chrono::steady_clock::now();
+        ViewCSSImp* view = new ViewCSSImp(window);
+        view->constructComputedStyles();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << count << " thread(s): " <<
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " usec\n";
+        delete view;
+    }
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     css::CSSStyleSheet defaultStyleSheet;
     Document document;
 
+    testRuleSet();
+
     // Load the default CSS file
     if (1 < argc) {
         std::ifstream stream(argv[1]);
@@ -113,6 +218,10 @@ int main(int argc, char** argv)
         getDOMImplementation()->setDefaultStyleSheet(defaultStyleSheet);
     }
 
+    // CSSStyle.test default.css page.html runs the benchmark instead.
+    if (2 < argc)
+        return benchmark(argv[2]);
+
     document = loadDocument(htmlDocument);
     assert(document);
 
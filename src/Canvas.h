@@ -32,6 +32,8 @@ public:
     void shutdown();
 
     void beginRender(unsigned backgroundColor);
+    // Repaints only the specified region over the previous contents.
+    void beginRender(unsigned backgroundColor, int left, int top, int width, int height);
     void endRender();
 
     void beginTranslucent();
@@ -20,6 +20,19 @@
 #include <assert.h>
 
 GLuint Canvas::Impl::currentFrameBuffer = 0;
+std::deque<Canvas::Impl::FrameBuffer> Canvas::Impl::pool;
+
+void Canvas::Impl::deleteFrameBuffer(const FrameBuffer& fb)
+{
+    if (GLEW_ARB_framebuffer_object) {
+        glDeleteFramebuffers(1, &fb.frameBuffer);
+        glDeleteRenderbuffers(1, &fb.renderBuffer);
+    } else {
+        glDeleteFramebuffersEXT(1, &fb.frameBuffer);
+        glDeleteRenderbuffersEXT(1, &fb.renderBuffer);
+    }
+    glDeleteTextures(1, &fb.texture);
+}
 
 void Canvas::Impl::setup(int w, int h)
 {
@@ -29,6 +42,17 @@ void Canvas::Impl::setup(int w, int h)
     width = w;
     height = h;
 
+    // Reuse a framebuffer of the same size released by another canvas.
+    for (auto i = pool.begin(); i != pool.end(); ++i) {
+        if (i->width == width && i->height == height) {
+            frameBuffer = i->frameBuffer;
+            renderBuffer = i->renderBuffer;
+            texture = i->texture;
+            pool.erase(i);
+            return;
+        }
+    }
+
     // Setup texture
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
@@ -71,28 +95,28 @@ void Canvas::Impl::shutdown()
     if (width == 0 && height == 0)
         return;
 
-    if (GLEW_ARB_framebuffer_object) {
-        glDeleteFramebuffers(1, &frameBuffer);
-        glDeleteRenderbuffers(1, &renderBuffer);
-    } else {
-        glDeleteFramebuffersEXT(1, &frameBuffer);
-        glDeleteRenderbuffersEXT(1, &renderBuffer);
-    }
-    if (texture) {
-        glDeleteTextures(1, &texture);
-        texture = 0;
+    pool.push_front(FrameBuffer{ width, height, frameBuffer, renderBuffer, texture });
+    if (MaxPooledFrameBuffers < pool.size()) {
+        deleteFrameBuffer(pool.back());
+        pool.pop_back();
     }
     while (!translucents.empty()) {
         GLuint tex = translucents.back();
         glDeleteTextures(1, &tex);
         translucents.pop_back();
     }
+    while (!spareTranslucents.empty()) {
+        GLuint tex = spareTranslucents.back();
+        glDeleteTextures(1, &tex);
+        spareTranslucents.pop_back();
+    }
     frameBuffer = 0;
     renderBuffer = 0;
+    texture = 0;
     width = height = 0;
 }
 
-void Canvas::Impl::beginRender(unsigned backgroundColor)
+void Canvas::Impl::beginRender(unsigned backgroundColor, int left, int top, int w, int h)
 {
     GLint v[4];
     glGetIntegerv(GL_VIEWPORT, v);
@@ -117,6 +141,11 @@ void Canvas::Impl::beginRender(unsigned backgroundColor)
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
 
+    // Note the scissor box of the parent canvas, if any, is restored by endRender().
+    glPushAttrib(GL_SCISSOR_BIT);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(left, height - (top + h), w, h);
+
     glClearColor(((backgroundColor >> 16) & 255) / 255.0f,
                  ((backgroundColor >> 8) & 255) / 255.0f,
                  (backgroundColor & 255) / 255.0f,
@@ -126,6 +155,8 @@ void Canvas::Impl::beginRender(unsigned backgroundColor)
 
 void Canvas::Impl::endRender()
 {
+    glPopAttrib();
+
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
 
@@ -142,13 +173,18 @@ void Canvas::Impl::endRender()
 void Canvas::Impl::beginTranslucent()
 {
     GLuint tex;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    if (!spareTranslucents.empty()) {
+        tex = spareTranslucents.back();
+        spareTranslucents.pop_back();
+    } else {
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    }
     translucents.push_back(tex);
 
     glFlush();
@@ -181,7 +217,7 @@ void Canvas::Impl::endTranslucent(float alpha)
     alphaBlend(width, height, alpha, tex);
     glPopMatrix();
 
-    glDeleteTextures(1, &tex);
+    spareTranslucents.push_back(tex);
 }
 
 void Canvas::Impl::render(int w, int h)
@@ -265,6 +301,11 @@ void Canvas::beginRender(unsigned backgroundColor)
     pimpl->beginRender(backgroundColor);
 }
 
+void Canvas::beginRender(unsigned backgroundColor, int left, int top, int width, int height)
+{
+    pimpl->beginRender(backgroundColor, left, top, width, height);
+}
+
 void Canvas::endRender()
 {
     pimpl->endRender();
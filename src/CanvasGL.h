@@ -26,6 +26,18 @@
 
 class Canvas::Impl
 {
+    // A framebuffer released by a canvas, kept to be reused by a canvas of
+    // the same size.
+    struct FrameBuffer
+    {
+        int width;
+        int height;
+        GLuint frameBuffer;
+        GLuint renderBuffer;
+        GLuint texture;
+    };
+    static const size_t MaxPooledFrameBuffers = 4;
+
     float x;
     float y;
     int width;
@@ -34,9 +46,13 @@ class Canvas::Impl
     GLuint renderBuffer;
     GLuint texture;
     std::deque<GLuint> translucents;    // alpha blend textures
+    std::deque<GLuint> spareTranslucents;   // alpha blend textures to be reused
 
     GLuint savedFrameBuffer;
     static GLuint currentFrameBuffer;
+    static std::deque<FrameBuffer> pool;    // the most recently released first
+
+    static void deleteFrameBuffer(const FrameBuffer& fb);
 
 public:
     Impl() :
@@ -57,7 +73,10 @@ public:
     void setup(int width, int height);
     void shutdown();
 
-    void beginRender(unsigned backgroundColor);
+    void beginRender(unsigned backgroundColor) {
+        beginRender(backgroundColor, 0, 0, width, height);
+    }
+    void beginRender(unsigned backgroundColor, int left, int top, int w, int h);
     void endRender();
 
     void beginTranslucent();
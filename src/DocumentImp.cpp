@@ -104,12 +104,20 @@
 #include "html/HTMLTitleElementImp.h"
 #include "html/HTMLUListElementImp.h"
 #include "html/HTMLUnknownElementImp.h"
+#include "html/HTMLUtil.h"
 #include "html/HTMLVideoElementImp.h"
 
+#include "Atom.h"
 #include "Test.util.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+namespace {
+
+constexpr auto Intern = &one_at_a_time::hash<char16_t>;
+
+}
+
 DocumentImp::DocumentImp(const std::u16string& url) :
     ObjectMixin(nullptr),
     url(url),
@@ -381,207 +389,362 @@ Element DocumentImp::createElement(const std::u16string& localName)
     if (!dynamic_cast<XMLDocumentImp*>(this))
         toLower(name);
 
-    // Checked in the order of descriptions in the HTML specification
-    if (name == u"html")
-        return std::make_shared<HTMLHtmlElementImp>(this);
-    if (name == u"head")
-        return std::make_shared<HTMLHeadElementImp>(this);
-    if (name == u"title")
-        return std::make_shared<HTMLTitleElementImp>(this);
-    if (name == u"base")
-        return std::make_shared<HTMLBaseElementImp>(this);
-    if (name == u"link")
-        return std::make_shared<HTMLLinkElementImp>(this);
-    if (name == u"meta")
-        return std::make_shared<HTMLMetaElementImp>(this);
-    if (name == u"style")
-        return std::make_shared<HTMLStyleElementImp>(this);
-    if (name == u"script")
-        return std::make_shared<HTMLScriptElementImp>(this);
-    if (name == u"noscript")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"body")
-        return std::make_shared<HTMLBodyElementImp>(this);
-    if (name == u"section" ||
-        name == u"nav" ||
-        name == u"article" ||
-        name == u"aside")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"h1" ||
-        name == u"h2" ||
-        name == u"h3" ||
-        name == u"h4" ||
-        name == u"h5" ||
-        name == u"h6")
-        return std::make_shared<HTMLHeadingElementImp>(this, name);
-    if (name == u"hgroup" ||
-        name == u"header" ||
-        name == u"footer" ||
-        name == u"address")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"p")
-        return std::make_shared<HTMLParagraphElementImp>(this);
-    if (name == u"hr")
-        return std::make_shared<HTMLHRElementImp>(this);
-    if (name == u"pre")
-        return std::make_shared<HTMLPreElementImp>(this);
-    if (name == u"blockquote")
-        return std::make_shared<HTMLQuoteElementImp>(this, name);
-    if (name == u"ol")
-        return std::make_shared<HTMLOListElementImp>(this);
-    if (name == u"ul")
-        return std::make_shared<HTMLUListElementImp>(this);
-    if (name == u"li")
-        return std::make_shared<HTMLLIElementImp>(this);
-    if (name == u"dl")
-        return std::make_shared<HTMLDListElementImp>(this);
-    if (name == u"dt" ||
-        name == u"dd" ||
-        name == u"figure" ||
-        name == u"figcaption")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"div")
-        return std::make_shared<HTMLDivElementImp>(this);
-    if (name == u"a")
-        return std::make_shared<HTMLAnchorElementImp>(this);
-    if (name == u"em" ||
-        name == u"strong" ||
-        name == u"small" ||
-        name == u"s" ||
-        name == u"cite")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"q")
-        return std::make_shared<HTMLQuoteElementImp>(this, name);
-    if (name == u"dfn" ||
-        name == u"abbr")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"time")
-        return std::make_shared<HTMLTimeElementImp>(this);
-    if (name == u"code" ||
-        name == u"var" ||
-        name == u"samp" ||
-        name == u"kbd" ||
-        name == u"sub" ||
-        name == u"sup" ||
-        name == u"i" ||
-        name == u"b" ||
-        name == u"u" ||
-        name == u"mark" ||
-        name == u"ruby" ||
-        name == u"rt" ||
-        name == u"rp" ||
-        name == u"bdi" ||
-        name == u"bdo")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"span")
-        return std::make_shared<HTMLSpanElementImp>(this);
-    if (name == u"br")
-        return std::make_shared<HTMLBRElementImp>(this);
-    if (name == u"wbr")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"ins" ||
-        name == u"del")
-        return std::make_shared<HTMLModElementImp>(this, name);
-    if (name == u"img")
-        return std::make_shared<HTMLImageElementImp>(this);
-    if (name == u"iframe") {
-        auto context = getDefaultWindow();
-        assert(context);
-        auto iframe = std::make_shared<HTMLIFrameElementImp>(this);
-        iframe->open(u"about:blank", context->isDeskTop() ? WindowProxy::TopLevel : 0);
-        return iframe;
-    }
-    if (name == u"embed")
-        return std::make_shared<HTMLEmbedElementImp>(this);
-    if (name == u"object")
-        return std::make_shared<HTMLObjectElementImp>(this);
-    if (name == u"param")
-        return std::make_shared<HTMLParamElementImp>(this);
-    if (name == u"video")
-        return std::make_shared<HTMLVideoElementImp>(this);
-    if (name == u"audio")
-        return std::make_shared<HTMLAudioElementImp>(this);
-    if (name == u"source")
-        return std::make_shared<HTMLSourceElementImp>(this);
-    if (name == u"canvas")
-        return std::make_shared<HTMLCanvasElementImp>(this);
-    if (name == u"map")
-        return std::make_shared<HTMLMapElementImp>(this);
-    if (name == u"area")
-        return std::make_shared<HTMLAreaElementImp>(this);
-    if (name == u"table")
-        return std::make_shared<HTMLTableElementImp>(this);
-    if (name == u"caption")
-        return std::make_shared<HTMLTableCaptionElementImp>(this);
-    if (name == u"colgroup" ||
-        name == u"col")
-        return std::make_shared<HTMLTableColElementImp>(this, name);
-    if (name == u"tbody" ||
-        name == u"thead" ||
-        name == u"tfoot")
-        return std::make_shared<HTMLTableSectionElementImp>(this, name);
-    if (name == u"tr")
-        return std::make_shared<HTMLTableRowElementImp>(this);
-    if (name == u"td")
-        return std::make_shared<HTMLTableDataCellElementImp>(this);
-    if (name == u"th")
-        return std::make_shared<HTMLTableHeaderCellElementImp>(this);
-    if (name == u"form")
-        return std::make_shared<HTMLFormElementImp>(this);
-    if (name == u"fieldset")
-        return std::make_shared<HTMLFieldSetElementImp>(this);
-    if (name == u"legend")
-        return std::make_shared<HTMLLegendElementImp>(this);
-    if (name == u"label")
-        return std::make_shared<HTMLLabelElementImp>(this);
-    if (name == u"input")
-        return std::make_shared<HTMLInputElementImp>(this);
-    if (name == u"button")
-        return std::make_shared<HTMLButtonElementImp>(this);
-    if (name == u"select")
-        return std::make_shared<HTMLSelectElementImp>(this);
-    if (name == u"datalist")
-        return std::make_shared<HTMLDataListElementImp>(this);
-    if (name == u"optgroup")
-        return std::make_shared<HTMLOptGroupElementImp>(this);
-    if (name == u"option")
-        return std::make_shared<HTMLOptionElementImp>(this);
-    if (name == u"textarea")
-        return std::make_shared<HTMLTextAreaElementImp>(this);
-    if (name == u"keygen")
-        return std::make_shared<HTMLKeygenElementImp>(this);
-    if (name == u"output")
-        return std::make_shared<HTMLOutputElementImp>(this);
-    if (name == u"progress")
-        return std::make_shared<HTMLProgressElementImp>(this);
-    if (name == u"meter")
-        return std::make_shared<HTMLMeterElementImp>(this);
-    if (name == u"details")
-        return std::make_shared<HTMLDetailsElementImp>(this);
-    if (name == u"summary")
-        return std::make_shared<HTMLElementImp>(this, name);
-    if (name == u"command")
-        return std::make_shared<HTMLCommandElementImp>(this);
-    if (name == u"menu")
-        return std::make_shared<HTMLMenuElementImp>(this);
-
-    if (name == u"binding")
-        return std::make_shared<HTMLBindingElementImp>(this);
-    if (name == u"template")
-        return std::make_shared<HTMLTemplateElementImp>(this);
-    if (name == u"implementation")
-        return std::make_shared<HTMLScriptElementImp>(this, name);
-
+    // Checked in the order of descriptions in the HTML specification. The
+    // name is compared in each case as well since an unknown name can have
+    // the same hash as a known one.
+    switch (Atom::computeHash(name)) {
+    case Intern(u"html"):
+        if (name == u"html")
+            return std::make_shared<HTMLHtmlElementImp>(this);
+        break;
+    case Intern(u"head"):
+        if (name == u"head")
+            return std::make_shared<HTMLHeadElementImp>(this);
+        break;
+    case Intern(u"title"):
+        if (name == u"title")
+            return std::make_shared<HTMLTitleElementImp>(this);
+        break;
+    case Intern(u"base"):
+        if (name == u"base")
+            return std::make_shared<HTMLBaseElementImp>(this);
+        break;
+    case Intern(u"link"):
+        if (name == u"link")
+            return std::make_shared<HTMLLinkElementImp>(this);
+        break;
+    case Intern(u"meta"):
+        if (name == u"meta")
+            return std::make_shared<HTMLMetaElementImp>(this);
+        break;
+    case Intern(u"style"):
+        if (name == u"style")
+            return std::make_shared<HTMLStyleElementImp>(this);
+        break;
+    case Intern(u"script"):
+        if (name == u"script")
+            return std::make_shared<HTMLScriptElementImp>(this);
+        break;
+    case Intern(u"noscript"):
+        if (name == u"noscript")
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"body"):
+        if (name == u"body")
+            return std::make_shared<HTMLBodyElementImp>(this);
+        break;
+    case Intern(u"section"):
+    case Intern(u"nav"):
+    case Intern(u"article"):
+    case Intern(u"aside"):
+        if (0 <= findKeyword(name, { u"section", u"nav", u"article", u"aside" }))
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"h1"):
+    case Intern(u"h2"):
+    case Intern(u"h3"):
+    case Intern(u"h4"):
+    case Intern(u"h5"):
+    case Intern(u"h6"):
+        if (0 <= findKeyword(name, { u"h1", u"h2", u"h3", u"h4", u"h5", u"h6" }))
+            return std::make_shared<HTMLHeadingElementImp>(this, name);
+        break;
+    case Intern(u"hgroup"):
+    case Intern(u"header"):
+    case Intern(u"footer"):
+    case Intern(u"address"):
+        if (0 <= findKeyword(name, { u"hgroup", u"header", u"footer", u"address" }))
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"p"):
+        if (name == u"p")
+            return std::make_shared<HTMLParagraphElementImp>(this);
+        break;
+    case Intern(u"hr"):
+        if (name == u"hr")
+            return std::make_shared<HTMLHRElementImp>(this);
+        break;
+    case Intern(u"pre"):
+        if (name == u"pre")
+            return std::make_shared<HTMLPreElementImp>(this);
+        break;
+    case Intern(u"blockquote"):
+        if (name == u"blockquote")
+            return std::make_shared<HTMLQuoteElementImp>(this, name);
+        break;
+    case Intern(u"ol"):
+        if (name == u"ol")
+            return std::make_shared<HTMLOListElementImp>(this);
+        break;
+    case Intern(u"ul"):
+        if (name == u"ul")
+            return std::make_shared<HTMLUListElementImp>(this);
+        break;
+    case Intern(u"li"):
+        if (name == u"li")
+            return std::make_shared<HTMLLIElementImp>(this);
+        break;
+    case Intern(u"dl"):
+        if (name == u"dl")
+            return std::make_shared<HTMLDListElementImp>(this);
+        break;
+    case Intern(u"dt"):
+    case Intern(u"dd"):
+    case Intern(u"figure"):
+    case Intern(u"figcaption"):
+        if (0 <= findKeyword(name, { u"dt", u"dd", u"figure", u"figcaption" }))
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"div"):
+        if (name == u"div")
+            return std::make_shared<HTMLDivElementImp>(this);
+        break;
+    case Intern(u"a"):
+        if (name == u"a")
+            return std::make_shared<HTMLAnchorElementImp>(this);
+        break;
+    case Intern(u"em"):
+    case Intern(u"strong"):
+    case Intern(u"small"):
+    case Intern(u"s"):
+    case Intern(u"cite"):
+        if (0 <= findKeyword(name, { u"em", u"strong", u"small", u"s", u"cite" }))
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"q"):
+        if (name == u"q")
+            return std::make_shared<HTMLQuoteElementImp>(this, name);
+        break;
+    case Intern(u"dfn"):
+    case Intern(u"abbr"):
+        if (0 <= findKeyword(name, { u"dfn", u"abbr" }))
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"time"):
+        if (name == u"time")
+            return std::make_shared<HTMLTimeElementImp>(this);
+        break;
+    case Intern(u"code"):
+    case Intern(u"var"):
+    case Intern(u"samp"):
+    case Intern(u"kbd"):
+    case Intern(u"sub"):
+    case Intern(u"sup"):
+    case Intern(u"i"):
+    case Intern(u"b"):
+    case Intern(u"u"):
+    case Intern(u"mark"):
+    case Intern(u"ruby"):
+    case Intern(u"rt"):
+    case Intern(u"rp"):
+    case Intern(u"bdi"):
+    case Intern(u"bdo"):
+        if (0 <= findKeyword(name, { u"code", u"var", u"samp", u"kbd", u"sub", u"sup", u"i", u"b", u"u", u"mark", u"ruby", u"rt", u"rp", u"bdi", u"bdo" }))
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"span"):
+        if (name == u"span")
+            return std::make_shared<HTMLSpanElementImp>(this);
+        break;
+    case Intern(u"br"):
+        if (name == u"br")
+            return std::make_shared<HTMLBRElementImp>(this);
+        break;
+    case Intern(u"wbr"):
+        if (name == u"wbr")
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"ins"):
+    case Intern(u"del"):
+        if (0 <= findKeyword(name, { u"ins", u"del" }))
+            return std::make_shared<HTMLModElementImp>(this, name);
+        break;
+    case Intern(u"img"):
+        if (name == u"img")
+            return std::make_shared<HTMLImageElementImp>(this);
+        break;
+    case Intern(u"iframe"):
+        if (name == u"iframe") {
+            auto context = getDefaultWindow();
+            assert(context);
+            auto iframe = std::make_shared<HTMLIFrameElementImp>(this);
+            iframe->open(u"about:blank", context->isDeskTop() ? WindowProxy::TopLevel : 0);
+            return iframe;
+        }
+        break;
+    case Intern(u"embed"):
+        if (name == u"embed")
+            return std::make_shared<HTMLEmbedElementImp>(this);
+        break;
+    case Intern(u"object"):
+        if (name == u"object")
+            return std::make_shared<HTMLObjectElementImp>(this);
+        break;
+    case Intern(u"param"):
+        if (name == u"param")
+            return std::make_shared<HTMLParamElementImp>(this);
+        break;
+    case Intern(u"video"):
+        if (name == u"video")
+            return std::make_shared<HTMLVideoElementImp>(this);
+        break;
+    case Intern(u"audio"):
+        if (name == u"audio")
+            return std::make_shared<HTMLAudioElementImp>(this);
+        break;
+    case Intern(u"source"):
+        if (name == u"source")
+            return std::make_shared<HTMLSourceElementImp>(this);
+        break;
+    case Intern(u"canvas"):
+        if (name == u"canvas")
+            return std::make_shared<HTMLCanvasElementImp>(this);
+        break;
+    case Intern(u"map"):
+        if (name == u"map")
+            return std::make_shared<HTMLMapElementImp>(this);
+        break;
+    case Intern(u"area"):
+        if (name == u"area")
+            return std::make_shared<HTMLAreaElementImp>(this);
+        break;
+    case Intern(u"table"):
+        if (name == u"table")
+            return std::make_shared<HTMLTableElementImp>(this);
+        break;
+    case Intern(u"caption"):
+        if (name == u"caption")
+            return std::make_shared<HTMLTableCaptionElementImp>(this);
+        break;
+    case Intern(u"colgroup"):
+    case Intern(u"col"):
+        if (0 <= findKeyword(name, { u"colgroup", u"col" }))
+            return std::make_shared<HTMLTableColElementImp>(this, name);
+        break;
+    case Intern(u"tbody"):
+    case Intern(u"thead"):
+    case Intern(u"tfoot"):
+        if (0 <= findKeyword(name, { u"tbody", u"thead", u"tfoot" }))
+            return std::make_shared<HTMLTableSectionElementImp>(this, name);
+        break;
+    case Intern(u"tr"):
+        if (name == u"tr")
+            return std::make_shared<HTMLTableRowElementImp>(this);
+        break;
+    case Intern(u"td"):
+        if (name == u"td")
+            return std::make_shared<HTMLTableDataCellElementImp>(this);
+        break;
+    case Intern(u"th"):
+        if (name == u"th")
+            return std::make_shared<HTMLTableHeaderCellElementImp>(this);
+        break;
+    case Intern(u"form"):
+        if (name == u"form")
+            return std::make_shared<HTMLFormElementImp>(this);
+        break;
+    case Intern(u"fieldset"):
+        if (name == u"fieldset")
+            return std::make_shared<HTMLFieldSetElementImp>(this);
+        break;
+    case Intern(u"legend"):
+        if (name == u"legend")
+            return std::make_shared<HTMLLegendElementImp>(this);
+        break;
+    case Intern(u"label"):
+        if (name == u"label")
+            return std::make_shared<HTMLLabelElementImp>(this);
+        break;
+    case Intern(u"input"):
+        if (name == u"input")
+            return std::make_shared<HTMLInputElementImp>(this);
+        break;
+    case Intern(u"button"):
+        if (name == u"button")
+            return std::make_shared<HTMLButtonElementImp>(this);
+        break;
+    case Intern(u"select"):
+        if (name == u"select")
+            return std::make_shared<HTMLSelectElementImp>(this);
+        break;
+    case Intern(u"datalist"):
+        if (name == u"datalist")
+            return std::make_shared<HTMLDataListElementImp>(this);
+        break;
+    case Intern(u"optgroup"):
+        if (name == u"optgroup")
+            return std::make_shared<HTMLOptGroupElementImp>(this);
+        break;
+    case Intern(u"option"):
+        if (name == u"option")
+            return std::make_shared<HTMLOptionElementImp>(this);
+        break;
+    case Intern(u"textarea"):
+        if (name == u"textarea")
+            return std::make_shared<HTMLTextAreaElementImp>(this);
+        break;
+    case Intern(u"keygen"):
+        if (name == u"keygen")
+            return std::make_shared<HTMLKeygenElementImp>(this);
+        break;
+    case Intern(u"output"):
+        if (name == u"output")
+            return std::make_shared<HTMLOutputElementImp>(this);
+        break;
+    case Intern(u"progress"):
+        if (name == u"progress")
+            return std::make_shared<HTMLProgressElementImp>(this);
+        break;
+    case Intern(u"meter"):
+        if (name == u"meter")
+            return std::make_shared<HTMLMeterElementImp>(this);
+        break;
+    case Intern(u"details"):
+        if (name == u"details")
+            return std::make_shared<HTMLDetailsElementImp>(this);
+        break;
+    case Intern(u"summary"):
+        if (name == u"summary")
+            return std::make_shared<HTMLElementImp>(this, name);
+        break;
+    case Intern(u"command"):
+        if (name == u"command")
+            return std::make_shared<HTMLCommandElementImp>(this);
+        break;
+    case Intern(u"menu"):
+        if (name == u"menu")
+            return std::make_shared<HTMLMenuElementImp>(this);
+        break;
+
+    case Intern(u"binding"):
+        if (name == u"binding")
+            return std::make_shared<HTMLBindingElementImp>(this);
+        break;
+    case Intern(u"template"):
+        if (name == u"template")
+            return std::make_shared<HTMLTemplateElementImp>(this);
+        break;
+    case Intern(u"implementation"):
+        if (name == u"implementation")
+            return std::make_shared<HTMLScriptElementImp>(this, name);
+        break;
     // Deprecated elements
-    if (name == u"applet")
-        return std::make_shared<HTMLAppletElementImp>(this);
-    if (name == u"center")   // shorthand for DIV align=center
-        return std::make_shared<HTMLDivElementImp>(this, name);
-    if (name == u"font")
-        return std::make_shared<HTMLFontElementImp>(this);
-    if (name == u"marquee")
-        return std::make_shared<HTMLMarqueeElementImp>(this);
-
+    case Intern(u"applet"):
+        if (name == u"applet")
+            return std::make_shared<HTMLAppletElementImp>(this);
+        break;
+    case Intern(u"center"):
+    case Intern(u"font"):
+        if (0 <= findKeyword(name, { u"center", u"font" }))
+            return std::make_shared<HTMLFontElementImp>(this);
+        break;
+    case Intern(u"marquee"):
+        if (name == u"marquee")
+            return std::make_shared<HTMLMarqueeElementImp>(this);
+        break;
+    default:
+        break;
+    }
     return std::make_shared<HTMLUnknownElementImp>(this, name);
 }
 
@@ -40,6 +40,25 @@
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+void ElementImp::updateAttributeCache(const std::u16string& name, const std::u16string& value)
+{
+    if (name == u"id")
+        id = value.empty() ? Atom() : Atom(value);
+    else if (name == u"class") {
+        classes.clear();
+        for (size_t pos = 0; pos < value.length();) {
+            if (isSpace(value[pos])) {
+                ++pos;
+                continue;
+            }
+            size_t start = pos++;
+            while (pos < value.length() && !isSpace(value[pos]))
+                ++pos;
+            classes.push_back(Atom(value.substr(start, pos - start)));
+        }
+    }
+}
+
 void ElementImp::setAttributes(const std::deque<Attr>& attributes)
 {
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
@@ -158,7 +177,7 @@ Nullable<std::u16string> ElementImp::getPrefix()
 
 std::u16string ElementImp::getLocalName()
 {
-    return localName;
+    return localName.toString();
 }
 
 std::u16string ElementImp::getTagName()
@@ -203,7 +222,10 @@ Nullable<std::u16string> ElementImp::getAttribute(const std::u16string& name)
         toLower(n);
     for (auto i = attributes.begin(); i != attributes.end(); ++i) {
         Attr attr = *i;
-        if (attr.getName() == n)
+        if (auto imp = std::dynamic_pointer_cast<AttrImp>(attr.self())) {
+            if (imp->hasName(n))
+                return imp->getValue();
+        } else if (attr.getName() == n)
             return attr.getValue();
     }
     return Nullable<std::u16string>();
@@ -231,7 +253,7 @@ void ElementImp::setAttribute(const std::u16string& name, const std::u16string&
         if (attr.getName() == n) {
             std::u16string prevValue = attr.getValue();
             if (prevValue != value) {
-                attr.setValue(value);
+                attr.setValue(value);  // also updates the attribute cache
                 events::MutationEvent event = std::make_shared<MutationEventImp>();
                 event.initMutationEvent(u"DOMAttrModified",
                                         true, false, attr, prevValue, value, n, events::MutationEvent::MODIFICATION);
@@ -240,8 +262,9 @@ void ElementImp::setAttribute(const std::u16string& name, const std::u16string&
             return;
         }
     }
-    if (Attr attr = std::make_shared<AttrImp>(Nullable<std::u16string>(), Nullable<std::u16string>(), n, value)) {
+    if (Attr attr = std::make_shared<AttrImp>(Nullable<std::u16string>(), Nullable<std::u16string>(), n, value, this)) {
         attributes.push_back(attr);
+        updateAttributeCache(n, value);
         events::MutationEvent event = std::make_shared<MutationEventImp>();
         event.initMutationEvent(u"DOMAttrModified",
                                 true, false, attr, u"", value, n, events::MutationEvent::ADDITION);
@@ -277,7 +300,7 @@ void ElementImp::setAttributeNS(const Nullable<std::u16string>& namespaceURI, co
         if (static_cast<std::u16string>(attr.getNamespaceURI()) == static_cast<std::u16string>(namespaceURI) && attr.getLocalName() == localName) {
             std::u16string prevValue = attr.getValue();
             if (prevValue != value) {
-                attr.setValue(value);
+                attr.setValue(value);  // also updates the attribute cache
                 // TODO: set prefix, too.
 
                 events::MutationEvent event = std::make_shared<MutationEventImp>();
@@ -288,8 +311,10 @@ void ElementImp::setAttributeNS(const Nullable<std::u16string>& namespaceURI, co
             return;
         }
     }
-    if (Attr attr = std::make_shared<AttrImp>(namespaceURI, prefix, localName, value)) {
+    if (Attr attr = std::make_shared<AttrImp>(namespaceURI, prefix, localName, value, this)) {
         attributes.push_back(attr);
+        if (!prefix.hasValue() && static_cast<std::u16string>(namespaceURI).empty())
+            updateAttributeCache(localName, value);
         events::MutationEvent event = std::make_shared<MutationEventImp>();
         event.initMutationEvent(u"DOMAttrModified",
                                 true, false, attr, u"", value, localName, events::MutationEvent::ADDITION);
@@ -310,6 +335,9 @@ void ElementImp::removeAttribute(const std::u16string& name)
                                     true, false, attr, attr.getValue(), u"", n, events::MutationEvent::REMOVAL);
             this->dispatchEvent(event);
             i = attributes.erase(i);
+            if (auto imp = std::dynamic_pointer_cast<AttrImp>(attr.self()))
+                imp->clearOwnerElement();
+            updateAttributeCache(n, u"");
         } else
             ++i;
     }
@@ -325,11 +353,28 @@ void ElementImp::removeAttributeNS(const Nullable<std::u16string>& namespaceURI,
                                     true, false, attr, attr.getValue(), u"", localName, events::MutationEvent::REMOVAL);
             this->dispatchEvent(event);
             i = attributes.erase(i);
+            if (auto imp = std::dynamic_pointer_cast<AttrImp>(attr.self()))
+                imp->clearOwnerElement();
+            if (!attr.getPrefix().hasValue() && static_cast<std::u16string>(namespaceURI).empty())
+                updateAttributeCache(localName, u"");
         } else
             ++i;
     }
 }
 
+bool ElementImp::hasSameAttributes(ElementImp* other)
+{
+    if (attributes.size() != other->attributes.size())
+        return false;
+    for (auto i = attributes.begin(), j = other->attributes.begin(); i != attributes.end(); ++i, ++j) {
+        Attr attr = *i;
+        Attr otherAttr = *j;
+        if (attr.getName() != otherAttr.getName() || attr.getValue() != otherAttr.getValue())
+            return false;
+    }
+    return true;
+}
+
 bool ElementImp::hasAttribute(const std::u16string& name)
 {
     // TODO: If the context node is in the HTML namespace and its ownerDocument is an HTML document
@@ -370,8 +415,11 @@ HTMLCollectionPtr ElementImp::getElementsByTagName(const ElementPtr& element, co
             list->addItem(e);
     } else {
         // TODO: Support non HTML document
+        Atom name = Atom::find(localName);
+        if (!name)
+            return list;
         for (ElementPtr e = element; e; e = e->getNextElement()) {
-            if (e->getLocalName() == localName)
+            if (e->localName == name)
                 list->addItem(e);
         }
     }
@@ -395,15 +443,23 @@ HTMLCollectionPtr ElementImp::getElementsByClassName(const ElementPtr& element,
     if (!list)
         return nullptr;
 
-    std::vector<std::u16string> classes;
-    boost::algorithm::split(classes, classNames, isSpace);
+    std::vector<std::u16string> names;
+    boost::algorithm::split(names, classNames, isSpace);
+    std::vector<Atom> classes;
+    for (auto i = names.begin(); i != names.end(); ++i) {
+        if (i->empty())
+            continue;
+        Atom name = Atom::find(*i);
+        if (!name)  // no element can have a class that has never been interned
+            return list;
+        classes.push_back(name);
+    }
+    if (classes.empty())
+        return list;
     for (ElementPtr e = element; e; e = e->getNextElement()) {
-        std::u16string c = e->getClassName();
-        std::vector<std::u16string> v;
-        boost::algorithm::split(v, c, isSpace);
         bool notFound = false;
         for (auto i = classes.begin(); i != classes.end(); ++i) {
-            if (std::find(v.begin(), v.end(), *i) == v.end()) {
+            if (!e->hasClass(*i)) {
                 notFound = true;
                 break;
             }
@@ -695,4 +751,13 @@ ElementImp::ElementImp(const ElementImp& org) :
 {
 }
 
+ElementImp::~ElementImp()
+{
+    // The attributes may outlive this element.
+    for (auto i = attributes.begin(); i != attributes.end(); ++i) {
+        if (auto imp = std::dynamic_pointer_cast<AttrImp>(i->self()))
+            imp->clearOwnerElement();
+    }
+}
+
 }}}}  // org::w3c::dom::bootstrap
@@ -35,8 +35,11 @@
 #include <org/w3c/dom/DOMTokenList.h>
 #include <org/w3c/dom/xbl2/XBLImplementationList.h>
 
+#include <algorithm>
 #include <deque>
+#include <vector>
 
+#include "Atom.h"
 #include "NodeImp.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
@@ -55,13 +58,21 @@ typedef std::shared_ptr<ElementImp> ElementPtr;
 class ElementImp : public ObjectMixin<ElementImp, NodeImp>
 {
     friend class AttrArray;
+    friend class AttrImp;
     friend class ViewCSSImp;
 
     std::u16string namespaceURI;
     std::u16string prefix;
-    std::u16string localName;
+    Atom localName;
     std::deque<Attr> attributes;
 
+    // The id and class attributes kept parsed for selector matching; these
+    // are updated whenever the attributes are set or removed.
+    Atom id;
+    std::vector<Atom> classes;
+
+    void updateAttributeCache(const std::u16string& name, const std::u16string& value);
+
     Element querySelector(CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view);
     void querySelectorAll(NodeListPtr nodeList, CSSSelectorsGroup* selectorsGroup, ViewCSSImp* view);
 
@@ -71,10 +82,25 @@ protected:
 public:
     ElementImp(DocumentImp* ownerDocument, const std::u16string& localName, const std::u16string& namespaceURI, const std::u16string& prefix = u"");
     ElementImp(const ElementImp& org);
+    ~ElementImp();
 
     void setAttributes(const std::deque<Attr>& attributes);
     ElementPtr getNextElement(const ElementPtr& root = nullptr);
 
+    const Atom& getLocalNameAtom() const {
+        return localName;
+    }
+    const Atom& getIdAtom() const {
+        return id;
+    }
+    const std::vector<Atom>& getClassAtoms() const {
+        return classes;
+    }
+    bool hasClass(const Atom& name) const {
+        return name && std::find(classes.begin(), classes.end(), name) != classes.end();
+    }
+    bool hasSameAttributes(ElementImp* other);
+
     // notify() is called when conditions that are not handled by DOM events
     // but still needed be processed occur; e.g., the element is popped off
     // the stack of open elements of an HTML parser.
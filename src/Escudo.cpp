@@ -72,28 +72,41 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
     HttpRequest::setCachePath(profile.createPath("cache"));
+    HttpCacheManager::getInstance().open(profile.createPath("cache"));
 
-    init(&argc, argv);
     initLogLevel(&argc, argv, 0);
-    initFonts(&argc, argv);
-    setWindowClass("escudo", "Escudo");
 
-    // Load the default style sheet
+    // Parse the built-in style sheets in the background while the window
+    // and the fonts are being initialized.
     std::string defaultSheet = profile.getProfilePath() + "/default.css";
     if (!profile.hasFile(defaultSheet))
         defaultSheet = std::string(argv[1]) + "/default.css";
-    getDOMImplementation()->setDefaultStyleSheet(loadStyleSheet(defaultSheet.c_str()));
-
-    // Load the presentational hints
     std::string presHints = profile.getProfilePath() + "/preshint.css";
     if (!profile.hasFile(presHints))
         presHints = std::string(argv[1]) + "/preshint.css";
-    getDOMImplementation()->setPresentationalHints(loadStyleSheet(presHints.c_str()));
-
-    // Load the user style sheet
     std::string userSheet = profile.getProfilePath() + "/user.css";
-    if (profile.hasFile(userSheet))
-        getDOMImplementation()->setUserStyleSheet(loadStyleSheet(userSheet.c_str()));
+    if (!profile.hasFile(userSheet))
+        userSheet.clear();
+    css::CSSStyleSheet defaultStyleSheet;
+    css::CSSStyleSheet presentationalHints;
+    css::CSSStyleSheet userStyleSheet;
+    std::thread styleSheetLoader([&]() {
+        defaultStyleSheet = loadStyleSheet(defaultSheet.c_str());
+        presentationalHints = loadStyleSheet(presHints.c_str());
+        if (!userSheet.empty())
+            userStyleSheet = loadStyleSheet(userSheet.c_str());
+    });
+
+    init(&argc, argv);
+    initFonts(&argc, argv);
+    setWindowClass("escudo", "Escudo");
+
+    styleSheetLoader.join();
+    getDOMImplementation()->setDefaultStyleSheet(defaultStyleSheet);
+    getDOMImplementation()->setPresentationalHints(presentationalHints);
+    if (userStyleSheet)
+        getDOMImplementation()->setUserStyleSheet(userStyleSheet);
+    recordTime("style sheets loaded");
 
     HttpRequest::setAboutPath(argv[1]);
     std::thread httpService(std::ref(HttpConnectionManager::getInstance()));
@@ -115,4 +128,6 @@ int main(int argc, char* argv[])
 
     HttpConnectionManager::getInstance().stop();
     httpService.join();
+
+    HttpCacheManager::getInstance().close();
 }
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <chrono>
+#include <iostream>
+
 #include "font/FontManager.h"
 #include "font/FontManagerBackEndGL.h"
 #include "font/FontDatabase.h"
@@ -22,6 +25,9 @@ FontManagerBackEndGL backend;
 
 unsigned int point = 48;
 
+unsigned benchmarkLines = 0;    // the number of lines rendered per frame in the benchmark
+const unsigned BenchmarkFrames = 100;
+
 void reshape(int w, int h)
 {
     glViewport(0, 0, w, h);
@@ -123,6 +129,44 @@ double renderCJKStrings(FontTexture* font, double y)
     return y;
 }
 
+// Renders a long text document at every frame, and reports the average
+// time taken to render a frame, excluding the first one that rasterizes the
+// glyphs.
+void benchmark()
+{
+    static unsigned frame = 0;
+    static double total = 0.0;
+    static const char16_t text[] = u"The quick brown fox jumps over the lazy dog. 0123456789 (+-*/=) THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG.";
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glColor3f(0.0, 0.0, 0.0);
+
+    backend.getFontFace(u"Liberation Serif");
+    FontTexture* font = backend.getFontTexture(point);
+    float scale = point * 96.0f / 72.0f;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned i = 0; i < benchmarkLines; ++i) {
+        glPushMatrix();
+        glTranslatef(24.0, 16.0 + (i % 64) * 16.0, 0.0);
+        glScalef(12.0 / scale, 12.0 / scale, 1.0);
+        font->renderText(text, sizeof text / sizeof text[0] - 1);
+        glPopMatrix();
+    }
+    glFinish();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    if (0 < frame)
+        total += elapsed.count();
+    glutSwapBuffers();
+
+    if (frame++ < BenchmarkFrames) {
+        glutPostRedisplay();
+        return;
+    }
+    std::cout << benchmarkLines << " lines: " << total / BenchmarkFrames << " ms/frame\n";
+    exit(EXIT_SUCCESS);
+}
+
 void display()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -172,7 +216,9 @@ int main(int argc, char* argv[])
     glutInitWindowSize(1024, 1024);
     glutCreateWindow(argv[0]);
     glutReshapeFunc(reshape);
-    glutDisplayFunc(display);
+    if (3 <= argc)
+        benchmarkLines = atoi(argv[2]);
+    glutDisplayFunc(benchmarkLines ? benchmark : display);
     glClearColor(1.0, 1.0, 1.0, 1.0);
     glEnable(GL_TEXTURE_2D);
     glDisable(GL_CULL_FACE);
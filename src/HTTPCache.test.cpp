@@ -0,0 +1,142 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "http/HTTPConnection.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+
+#include "Test.http.h"
+#include "Test.util.h"
+#include "utf.h"
+
+using namespace org::w3c::dom::bootstrap;
+
+namespace {
+
+HttpRequestPtr get(const std::string& url)
+{
+    HttpRequestPtr request(std::make_shared<HttpRequest>());
+    request->open(u"get", utfconv(url));
+    request->send();
+    while (request->getReadyState() != HttpRequest::DONE) {
+        HttpConnectionManager::getIOService().run_one();
+        HttpConnectionManager::getInstance().poll();
+    }
+    return request;
+}
+
+// Returns the size of the content of request, or -1 if it cannot be read.
+long long getContentSize(const HttpRequestPtr& request)
+{
+    if (request->getError())
+        return -1;
+    int fd = request->getContentDescriptor();
+    if (fd == -1)
+        return -1;
+    struct stat status;
+    long long size = (fstat(fd, &status) == 0) ? status.st_size : -1;
+    close(fd);
+    return size;
+}
+
+bool exists(const std::string& path)
+{
+    struct stat status;
+    return stat(path.c_str(), &status) == 0;
+}
+
+void removeDirectory(const std::string& path)
+{
+    if (DIR* dir = opendir(path.c_str())) {
+        while (struct dirent* entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+                remove((path + '/' + entry->d_name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+}
+
+int check(bool condition, const char* what)
+{
+    if (condition)
+        return 0;
+    std::cerr << "error: " << what << '\n';
+    return 1;
+}
+
+}  // namespace
+
+// Runs the HTTP cache twice against a local HTTP stand-in; the second run
+// must not fetch any content from the server.
+int main(int argc, char* argv[])
+{
+    initLogLevel(&argc, argv, 0);
+
+    char cachePath[] = "/tmp/esrille-cache-test-XXXXXX";
+    if (!mkdtemp(cachePath)) {
+        std::cerr << "error: cannot create a cache directory.\n";
+        return EXIT_FAILURE;
+    }
+    HttpRequest::setCachePath(cachePath);
+
+    HttpStandIn server;
+    long long length = server.getContentLength();
+    std::string base("http://127.0.0.1:" + std::to_string(server.getPort()));
+    HttpCacheManager& cache(HttpCacheManager::getInstance());
+    int result = 0;
+
+    // First run
+    cache.open(cachePath);
+    cache.setSaveInterval(0);
+    result += check(getContentSize(get(base + "/fresh")) == length, "first run: /fresh");
+    result += check(getContentSize(get(base + "/revalidate")) == length, "first run: /revalidate");
+    result += check(server.getBytesSent() == 2 * length, "first run: bytes fetched");
+    // The index must have been saved without waiting for close().
+    result += check(exists(std::string(cachePath) + "/index"), "first run: index not saved");
+    cache.close();
+    std::cout << "first run: " << server.getRequestCount() << " requests, " << server.getBytesSent() << " bytes\n";
+
+    // Second run: /fresh is served from the cache, and /revalidate is
+    // revalidated by If-None-Match.
+    server.reset();
+    cache.open(cachePath);
+    HttpRequestPtr fresh = get(base + "/fresh");
+    result += check(getContentSize(fresh) == length, "second run: /fresh");
+    result += check(getContentSize(get(base + "/revalidate")) == length, "second run: /revalidate");
+    result += check(server.getRequestCount() == 1, "second run: requests sent");
+    result += check(server.getBytesSent() == 0, "second run: bytes fetched");
+    std::cout << "second run: " << server.getRequestCount() << " requests, " << server.getBytesSent() << " bytes\n";
+
+    // An evicted body file stays until the last request referring to it is gone.
+    std::string filePath(fresh->getFilePath());
+    cache.setCapacity(0, 0);
+    result += check(cache.getEntryCount() == 0, "eviction");
+    result += check(getContentSize(fresh) == length, "eviction: body file in use removed");
+    fresh.reset();
+    result += check(!exists(filePath), "eviction: body file left behind");
+
+    cache.close();
+    server.stop();
+    removeDirectory(cachePath);
+    return result;
+}
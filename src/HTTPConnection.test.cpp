@@ -0,0 +1,154 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "http/HTTPConnection.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <boost/bind.hpp>
+
+#include "Test.http.h"
+#include "Test.util.h"
+#include "utf.h"
+
+using namespace org::w3c::dom::bootstrap;
+
+namespace {
+
+typedef boost::asio::ip::tcp::endpoint Endpoint;
+
+// A listening socket on the loopback interface whose backlog is full, so
+// that a connection attempt to it stays pending as to an unreachable host.
+class BlackHole
+{
+    boost::asio::ip::tcp::acceptor acceptor;
+    std::vector<int> fillers;
+
+public:
+    BlackHole(boost::asio::io_service& ioService) :
+        acceptor(ioService)
+    {
+        acceptor.open(boost::asio::ip::tcp::v4());
+        acceptor.bind(Endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        acceptor.listen(0);
+        Endpoint endpoint(acceptor.local_endpoint());
+        for (int i = 0; i < 4; ++i) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (fd == -1)
+                break;
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            connect(fd, endpoint.data(), endpoint.size());
+            fillers.push_back(fd);
+        }
+        usleep(100000);
+    }
+    ~BlackHole() {
+        for (auto i = fillers.begin(); i != fillers.end(); ++i)
+            close(*i);
+    }
+    Endpoint getEndpoint() const {
+        return acceptor.local_endpoint();
+    }
+};
+
+struct Resolution
+{
+    bool done;
+    boost::system::error_code err;
+    EndpointList endpoints;
+};
+
+void handleResolve(Resolution* resolution, const boost::system::error_code& err, const EndpointList& endpoints)
+{
+    resolution->done = true;
+    resolution->err = err;
+    resolution->endpoints = endpoints;
+}
+
+Resolution resolve(const std::string& hostname, const std::string& port)
+{
+    Resolution resolution = { false };
+    HttpConnectionManager::getInstance().resolve(hostname, port, boost::bind(handleResolve, &resolution, _1, _2));
+    while (!resolution.done)
+        HttpConnectionManager::getIOService().run_one();
+    return resolution;
+}
+
+HttpRequestPtr get(const std::string& url)
+{
+    HttpRequestPtr request(std::make_shared<HttpRequest>());
+    request->open(u"get", utfconv(url));
+    request->send();
+    while (request->getReadyState() != HttpRequest::DONE) {
+        HttpConnectionManager::getIOService().run_one();
+        HttpConnectionManager::getInstance().poll();
+    }
+    return request;
+}
+
+int check(bool condition, const char* what)
+{
+    if (condition)
+        return 0;
+    std::cerr << "error: " << what << '\n';
+    return 1;
+}
+
+}  // namespace
+
+// Tests the host cache and the connection racing with a local HTTP stand-in,
+// registering its endpoint for host names that cannot be resolved otherwise.
+int main(int argc, char* argv[])
+{
+    initLogLevel(&argc, argv, 0);
+
+    HttpConnectionManager& manager(HttpConnectionManager::getInstance());
+    HttpStandIn server;
+    std::string port(std::to_string(server.getPort()));
+    EndpointList stub(1, Endpoint(boost::asio::ip::address_v4::loopback(), server.getPort()));
+    int result = 0;
+
+    // The registered endpoints are used until the TTL expires.
+    manager.setHostCacheTTL(1);
+    manager.setHost("stub.invalid", port, stub);
+    Resolution resolution = resolve("stub.invalid", port);
+    result += check(!resolution.err && resolution.endpoints == stub, "host cache");
+    sleep(2);
+    resolution = resolve("stub.invalid", port);
+    result += check(resolution.err || resolution.endpoints != stub, "host cache: TTL");
+
+    // The first endpoint never answers; the second one has to be tried in
+    // 250 milliseconds rather than after the TCP connection timeout.
+    BlackHole blackHole(HttpConnectionManager::getIOService());
+    EndpointList endpoints;
+    endpoints.push_back(blackHole.getEndpoint());
+    endpoints.push_back(stub.front());
+    manager.setHostCacheTTL(60);
+    manager.setHost("race.invalid", port, endpoints);
+    auto start = std::chrono::steady_clock::now();
+    HttpRequestPtr request = get("http://race.invalid:" + port + "/");
+    long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    result += check(!request->getError() && request->getStatus() == 200, "connection racing");
+    result += check(250 <= elapsed && elapsed < 1000, "connection racing: fallback delay");
+    std::cout << "connected in " << elapsed << " ms\n";
+
+    server.stop();
+    return result;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2013 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ES_TEST_HTTP_H
+#define ES_TEST_HTTP_H
+
+#include <atomic>
+#include <istream>
+#include <string>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+// HttpStandIn is a minimal HTTP/1.1 server listening on the loopback
+// interface so that the HTTP stack can be tested without the network. Each
+// request is answered with a body of contentLength bytes, and then the
+// connection is closed. The path selects the response:
+//
+//   /fresh         fresh for an hour
+//   /revalidate    stale at once; 304 if If-None-Match matches
+//   otherwise      not to be stored
+class HttpStandIn
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor;
+    std::thread thread;
+    std::atomic_bool stopping;
+    std::atomic_uint requestCount;
+    std::atomic_ullong bytesSent;  // the number of the content bytes sent
+    size_t contentLength;
+
+    static const char* getETag() {
+        return "\"1\"";
+    }
+
+    void serve(boost::asio::ip::tcp::socket& socket) {
+        boost::system::error_code err;
+        boost::asio::streambuf buffer;
+        boost::asio::read_until(socket, buffer, "\r\n\r\n", err);
+        if (err)
+            return;
+        std::istream stream(&buffer);
+        std::string method;
+        std::string path;
+        std::string line;
+        stream >> method >> path;
+        std::getline(stream, line);
+        std::string etag;
+        while (std::getline(stream, line) && line != "\r") {
+            if (line.compare(0, 14, "If-None-Match:") == 0) {
+                size_t start = line.find_first_not_of(' ', 14);
+                size_t end = line.find_last_not_of("\r");
+                if (start != std::string::npos && start <= end)
+                    etag = line.substr(start, end - start + 1);
+            }
+        }
+        ++requestCount;
+
+        bool modified = true;
+        std::string response;
+        if (path == "/fresh")
+            response = "Cache-Control: max-age=3600\r\n";
+        else if (path == "/revalidate") {
+            response = "Cache-Control: max-age=0\r\n";
+            modified = (etag != getETag());
+        } else
+            response = "Cache-Control: no-store\r\n";
+        response += std::string("ETag: ") + getETag() + "\r\nConnection: close\r\n";
+        if (modified) {
+            response = "HTTP/1.1 200 OK\r\n" + response + "Content-Length: " + std::to_string(contentLength) + "\r\n\r\n";
+            response.append(contentLength, 'x');
+            bytesSent += contentLength;
+        } else
+            response = "HTTP/1.1 304 Not Modified\r\n" + response + "\r\n";
+        boost::asio::write(socket, boost::asio::buffer(response), err);
+        socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, err);
+    }
+
+    void run() {
+        while (!stopping) {
+            boost::asio::ip::tcp::socket socket(ioService);
+            boost::system::error_code err;
+            acceptor.accept(socket, err);
+            if (err || stopping)
+                break;
+            serve(socket);
+        }
+    }
+
+public:
+    HttpStandIn(size_t contentLength = 4096) :
+        acceptor(ioService, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        stopping(false),
+        requestCount(0),
+        bytesSent(0),
+        contentLength(contentLength)
+    {
+        thread = std::thread(&HttpStandIn::run, this);
+    }
+    ~HttpStandIn() {
+        stop();
+    }
+
+    void stop() {
+        if (!thread.joinable())
+            return;
+        stopping = true;
+        // Wake up the thread blocked in accept().
+        boost::asio::ip::tcp::socket socket(ioService);
+        boost::system::error_code err;
+        socket.connect(acceptor.local_endpoint(), err);
+        thread.join();
+    }
+
+    unsigned short getPort() const {
+        return acceptor.local_endpoint().port();
+    }
+    size_t getContentLength() const {
+        return contentLength;
+    }
+    unsigned getRequestCount() const {
+        return requestCount;
+    }
+    unsigned long long getBytesSent() const {
+        return bytesSent;
+    }
+    void reset() {
+        requestCount = 0;
+        bytesSent = 0;
+    }
+};
+
+#endif  // ES_TEST_HTTP_H
@@ -16,6 +16,10 @@
 
 #include "WindowProxy.h"
 
+#include <errno.h>
+#include <unistd.h>
+
+#include <chrono>
 #include <new>
 #include <iostream>
 #include <boost/version.hpp>
@@ -36,19 +40,58 @@
 #include "html/HTMLIFrameElementImp.h"
 #include "html/HTMLLinkElementImp.h"
 #include "html/HTMLScriptElementImp.h"
+#include "http/HTTPCache.h"
 #include "http/HTTPConnection.h"
 
 #include "Test.util.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
-WindowProxy::Parser::Parser(const DocumentPtr& document, int fd, const std::string& optionalEncoding) :
-    stream(fd, boost::iostreams::close_handle),
+std::streamsize WindowProxy::ContentSource::read(char* s, std::streamsize n)
+{
+    for (;;) {
+        // Check the state before reading so that no bytes written just before
+        // the completion are missed.
+        unsigned short state = request->getReadyState();
+        bool completed = state == HttpRequest::UNSENT || HttpRequest::COMPLETE <= state;
+        unsigned long long loaded = request->getLoadedBytes();
+        ssize_t count = ::read(fd, s, n);
+        if (0 < count)
+            return count;
+        if (count < 0 && errno != EINTR)
+            return -1;
+        if (completed || *cancelled)
+            return -1;
+        request->waitForContent(loaded, cancelled);
+    }
+}
+
+void WindowProxy::ContentSource::close()
+{
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+WindowProxy::Parser::Parser(const DocumentPtr& document, const HttpRequestPtr& request, const std::string& optionalEncoding) :
+    request(request),
+    cancelled(false),
+    stream(ContentSource(request->getContentDescriptor(), request, &cancelled)),
     htmlInputStream(stream, optionalEncoding),
-    tokenizer(&htmlInputStream),
+    speculator(&htmlInputStream),
+    tokenizer(speculator.getInput()),
     parser(document, &tokenizer)
 {
     document->setCharacterSet(utfconv(htmlInputStream.getEncoding()));
+    tokenizer.setSpeculativeTokenizer(&speculator);
+}
+
+WindowProxy::Parser::~Parser()
+{
+    // Let the worker thread of speculator stop waiting for the content.
+    cancelled = true;
+    request->wakeUp();
 }
 
 WindowProxy::WindowProxy(unsigned short flags) :
@@ -69,6 +112,8 @@ WindowProxy::WindowProxy(unsigned short flags) :
     zoomable(true),
     zoom(1.0f),
     faviconOverridable(false),
+    restyleTick(0),
+    restyleCost(0),
     windowDepth(0)
 {
 }
@@ -198,6 +243,122 @@ bool WindowProxy::isBindingDocumentWindow()
     return false;
 }
 
+DocumentPtr WindowProxy::openDocument()
+{
+    recordTime("%*shttp request %s", windowDepth * 2, "", (request->getReadyState() == HttpRequest::DONE) ? "done" : "loading");
+    // TODO: Check header
+    Document newDocument = getDOMImplementation()->createDocument(u"", u"", nullptr); // TODO: Create HTML document
+    DocumentPtr document = std::dynamic_pointer_cast<DocumentImp>(newDocument.self());
+    if (!document)
+        return nullptr;
+    // TODO: Fire a simple unload event.
+    document->setDefaultView(std::static_pointer_cast<WindowProxy>(self()));
+    document->setURL(request->getURL());
+    document->setLastModified(request->getLastModified());
+    window->setDocument(document);
+    if (!request->getError())
+        history->update(window);
+    else
+        document->setError(request->getError());
+    document->enter();
+    preloadBase.clear();
+    parser.reset(new(std::nothrow) Parser(document, request, request->getResponseMessage().getContentCharset()));
+    document->exit();
+    restyleTick = getTick();
+    return document;
+}
+
+// Returns true unless the background task is constructing the view from the
+// document, in which case the document must not be modified.
+bool WindowProxy::canParse()
+{
+    if (!(flags & Restyling))
+        return true;
+    if (!backgroundTask.isRestarting() && backgroundTask.getState() == BackgroundTask::Cascaded)
+        backgroundTask.wakeUp(BackgroundTask::Layout);
+    return false;
+}
+
+// Runs the parser until it reaches the end of the document or a parser-
+// blocking script, it runs out of the content received so far, or its time
+// slice expires. Returns true if the whole document has been parsed.
+bool WindowProxy::parse(const DocumentPtr& document)
+{
+    // Note the tokens are prepared in the background by the speculative
+    // tokenizer; the tree construction and JS run here.
+    document->enter();
+
+    if (!parser->processPendingParsingBlockingScript()) {
+        parser->scan(boost::bind(&WindowProxy::preload, this, document->getDocumentURI(), _1));
+        document->exit();
+        return false;
+    }
+    unsigned start = getTick();
+    Token token;
+    do {
+        if (!parser->isReady() || ParseTimeSlice <= getTick() - start || !parser->getToken(token)) {
+            document->exit();
+            return false;
+        }
+        if (preloadBase.empty() && token.getType() == Token::Type::StartTag && token.getName() == u"base")
+            setPreloadBase(document->getDocumentURI(), token);
+        parser->processToken(token);
+    } while (token.getType() != Token::Type::EndOfFile && !document->getPendingParsingBlockingScript());
+
+    if (document->getPendingParsingBlockingScript()) {
+        parser->scan(boost::bind(&WindowProxy::preload, this, document->getDocumentURI(), _1));
+        document->exit();
+        return false;
+    }
+    document->exit();
+    return true;
+}
+
+// Records the URL of the first <base> element with an href attribute, against
+// which the preloaded URLs are resolved.
+void WindowProxy::setPreloadBase(const std::u16string& documentURI, const Token& token)
+{
+    if (!preloadBase.empty())
+        return;
+    Nullable<std::u16string> href = token.getAttribute(u"href");
+    if (!href.hasValue())
+        return;
+    URL url(documentURI, href.value());
+    if (!url.isEmpty())
+        preloadBase = url;
+}
+
+// Requests the script, the style sheet, or the image referenced by a start
+// tag that has been tokenized ahead of the parser blocked by a script, so
+// that the fetches overlap with the blocking script.
+void WindowProxy::preload(const std::u16string& documentURI, const Token& token)
+{
+    const std::u16string& tag = token.getName();
+    Nullable<std::u16string> url;
+    if (tag == u"base") {
+        setPreloadBase(documentURI, token);
+        return;
+    }
+    if (tag == u"script" || tag == u"img")
+        url = token.getAttribute(u"src");
+    else if (tag == u"link") {
+        Nullable<std::u16string> rel = token.getAttribute(u"rel");
+        if (!rel.hasValue())
+            return;
+        std::u16string value = rel.value();
+        toLower(value);
+        if (!::contains(value, u"stylesheet") || ::contains(value, u"alternate"))
+            return;
+        url = token.getAttribute(u"href");
+    }
+    if (!url.hasValue() || url.value().empty())
+        return;
+    const std::u16string& base = preloadBase.empty() ? documentURI : preloadBase;
+    if (HttpCacheManager::getInstance().isAvailable(URL(base, url.value())))
+        return;
+    window->preload(base, url.value());
+}
+
 bool WindowProxy::poll()
 {
     if (!window)
@@ -205,8 +366,18 @@ bool WindowProxy::poll()
     auto document = window->getDocument();
 
     // Update the canvas before processing events.
-    if (request->getReadyState() == HttpRequest::DONE && document && backgroundTask.getState() == BackgroundTask::Done) {
+    if ((request->getReadyState() == HttpRequest::DONE || request->getReadyState() == HttpRequest::LOADING) &&
+        document && backgroundTask.getState() == BackgroundTask::Done) {
         ViewCSSImp* next = backgroundTask.getView();
+        if (next && (flags & Restyling)) {
+            // Measure the interval to the next restyle from here, so that a
+            // restyle that takes longer than RestyleInterval does not starve
+            // the parser.
+            unsigned now = getTick();
+            restyleCost = now - restyleTick;
+            restyleTick = now;
+            flags &= ~Restyling;
+        }
         updateView(next);
         if (view) {
             unsigned short gathered = viewFlags | view->gatherFlags();
@@ -252,7 +423,7 @@ bool WindowProxy::poll()
                 if (document && document->isBindingDocumentWindow(child))
                     view->setFlags(Box::NEED_SELECTOR_REMATCHING);
                 else
-                    view->setFlags(Box::NEED_REPAINT);
+                    view->invalidateChildWindow(child.get());
             }
         }
     }
@@ -262,55 +433,40 @@ bool WindowProxy::poll()
         break;
     case HttpRequest::OPENED:
     case HttpRequest::HEADERS_RECEIVED:
+        break;
     case HttpRequest::LOADING:
+        // Parse the document as its content arrives, and construct the view
+        // of the partial document from time to time.
+        if (!document) {
+            if (request->getLoadedBytes() < Parser::Lookahead || !(document = openDocument()))
+                break;
+        }
+        if (document->getReadyState() != u"loading" || !parser || !canParse())
+            break;
+        parse(document);
+        // Restyle at most as often as the last restyle cost allows.
+        unsigned interval = 2 * restyleCost;
+        if (interval < RestyleInterval)
+            interval = RestyleInterval;
+        if (!isBindingDocumentWindow() && interval <= getTick() - restyleTick) {
+            restyleTick = getTick();
+            document->resetStyleSheets();
+            flags |= Restyling;
+            backgroundTask.restart(BackgroundTask::Cascade);
+        }
         break;
     case HttpRequest::DONE:
         if (!document) {
-            recordTime("%*shttp request done", windowDepth * 2, "");
-            // TODO: Check header
-            Document newDocument = getDOMImplementation()->createDocument(u"", u"", nullptr); // TODO: Create HTML document
-            if ((document = std::dynamic_pointer_cast<DocumentImp>(newDocument.self()))) {
-                // TODO: Fire a simple unload event.
-                document->setDefaultView(std::static_pointer_cast<WindowProxy>(self()));
-                document->setURL(request->getURL());
-                document->setLastModified(request->getLastModified());
-                window->setDocument(document);
-                if (!request->getError())
-                    history->update(window);
-                else
-                    document->setError(request->getError());
-                document->enter();
-                parser.reset(new(std::nothrow) Parser(document, request->getContentDescriptor(), request->getResponseMessage().getContentCharset()));
-                document->exit();
-                if (!parser)
-                    break;  // TODO: error handling
-            } else
+            if (!(document = openDocument()))
                 break;  // TODO: error handling
-        }
+        } else if (document->getReadyState() == u"loading")
+            document->setLastModified(request->getLastModified());
         if (document->getReadyState() == u"loading") {
-            // TODO: Note white it would be nice to parse the HTML docucment in
-            // the background task, firstly we need to check if we can run JS
-            // in the background.
-
-            document->enter();
-
-            if (!parser->processPendingParsingBlockingScript()) {
-                document->exit();
-                break;
-            }
-            // TODO: run this in the background
-            Token token;
-            do {
-                token = parser->getToken();
-                parser->processToken(token);
-            } while (token.getType() != Token::Type::EndOfFile && !document->getPendingParsingBlockingScript());
-
-            if (document->getPendingParsingBlockingScript()) {
-                document->exit();
+            if (!parser || !canParse() || !parse(document))
                 break;
-            }
 
             // TODO: Check if the parser has been aborted.
+            document->enter();
             document->resetStyleSheets();
             setViewFlags(Box::NEED_SELECTOR_REMATCHING);
             if (!(flags & Loading) && !isBindingDocumentWindow()) { // Note a binding document does not create its view.
@@ -401,7 +557,7 @@ bool WindowProxy::poll()
     bool result = redisplay;
     redisplay = false;
     if (!result && view && view->hasExpired(getTick())) {
-        view->setFlags(Box::NEED_REPAINT);
+        view->invalidateAnimatedImages();
         result = true;
     }
     if (result)
@@ -411,19 +567,30 @@ bool WindowProxy::poll()
 
 void WindowProxy::render(ViewCSSImp* parentView)
 {
+    if (parentView)
+        parentView->addChildWindow(this, width, height);
     if (view) {
         std::string readyState = window->getDocument() ? utfconv(window->getDocument()->getReadyState()) : "";
         recordTime("%*srepaint begin: %s (%s)", windowDepth * 2, "", readyState.c_str(), view ? "render" : "canvas");
         if (view->gatherFlags() & Box::NEED_REPAINT) {
             view->clearFlags(Box::NEED_REPAINT);
-            // TODO: if the size of the canvas has not been changed, reuse the same canvas.
-            canvas.shutdown();
-            canvas.setup(width, height);
+            // Reuse the canvas unless the window has been resized.
+            bool resized = false;
+            if (canvas.getWidth() != static_cast<int>(width) || canvas.getHeight() != static_cast<int>(height)) {
+                canvas.shutdown();
+                canvas.setup(width, height);
+                resized = true;
+            }
 
             unsigned backgroundColor = view->getBackgroundColor();
             if (backgroundColor == 0 && !getParent())
                 backgroundColor = 0xffffffff;
-            canvas.beginRender(backgroundColor);
+            // Repaint only the damaged region over the previous frame if possible.
+            int left, top, right, bottom;
+            if (!resized && view->getDamage(left, top, right, bottom))
+                canvas.beginRender(backgroundColor, left, top, right - left, bottom - top);
+            else
+                canvas.beginRender(backgroundColor);
 
             view->render(parentView ? parentView->getClipCount() : 0);
             scrollWidth = view->getScrollWidth();
@@ -1039,6 +1206,8 @@ void WindowProxy::navigate(std::u16string url, bool replace, WindowProxy* srcWin
     }
 
     window = std::make_shared<WindowImp>();
+    parser.reset();
+    flags &= ~Restyling;
     request->abort();
     history->setReplace(replace);
     request->open(u"get", url.empty() ? u"about:blank" : url);
@@ -81,7 +81,8 @@ public:
     enum {
         DeskTop = 1,
         TopLevel = 2,
-        Loading = 4
+        Loading = 4,
+        Restyling = 8   // a view of the document being loaded is under construction
     };
 
 private:
@@ -173,17 +174,57 @@ private:
         bool wait();
     };
 
+    // ContentSource reads the content of an HTTP request that may still be
+    // loading. Instead of reporting the end of the file, read() waits for
+    // more bytes to arrive until the request completes or is cancelled.
+    class ContentSource
+    {
+        int fd;
+        HttpRequestPtr request;
+        const std::atomic_bool* cancelled;
+    public:
+        typedef char char_type;
+        struct category : boost::iostreams::source_tag, boost::iostreams::closable_tag {};
+
+        ContentSource(int fd, const HttpRequestPtr& request, const std::atomic_bool* cancelled) :
+            fd(fd),
+            request(request),
+            cancelled(cancelled)
+        {}
+        std::streamsize read(char* s, std::streamsize n);
+        void close();
+    };
+
+    // Parser decodes and tokenizes the content in the background with
+    // SpeculativeTokenizer, while the tree construction and the scripts run
+    // in the main thread.
     class Parser
     {
-        boost::iostreams::stream<boost::iostreams::file_descriptor_source> stream;
+        HttpRequestPtr request;
+        std::atomic_bool cancelled;
+        boost::iostreams::stream<ContentSource> stream;
         HTMLInputStream htmlInputStream;
+        SpeculativeTokenizer speculator;
         HTMLTokenizer tokenizer;
         HTMLParser parser;
     public:
-        Parser(const DocumentPtr& document, int fd, const std::string& optionalEncoding);
+        // The number of bytes that need to be available before creating the
+        // parser so that the encoding can be determined without waiting for
+        // the network.
+        static const unsigned Lookahead = 8192;
+
+        Parser(const DocumentPtr& document, const HttpRequestPtr& request, const std::string& optionalEncoding);
+        ~Parser();
+
+        // Returns true if the next token can be read without waiting for
+        // more content to arrive.
+        bool isReady() {
+            return speculator.isReady(&tokenizer);
+        }
 
-        Token getToken() {
-            return tokenizer.getToken();
+        // Returns false if the next token is not ready yet.
+        bool getToken(Token& token) {
+            return tokenizer.getToken(token);
         }
         bool processToken(Token& token) {
             return parser.processToken(token);
@@ -195,6 +236,10 @@ private:
         bool processPendingParsingBlockingScript() {
             return parser.processPendingParsingBlockingScript();
         }
+
+        void scan(boost::function<void (const Token&)> f) {
+            speculator.scan(f);
+        }
     };
 
     HttpRequestPtr request;
@@ -235,6 +280,16 @@ private:
 
     bool faviconOverridable;
 
+    // for progressive rendering; in milliseconds
+    static const unsigned ParseTimeSlice = 50;
+    static const unsigned RestyleInterval = 250;
+    unsigned restyleTick;   // when the last restyle has started or ended
+    unsigned restyleCost;   // how long the last restyle took
+
+    // the URL of the first <base href> seen by the parser or by the scan for
+    // preloading; empty if none has been seen yet
+    std::u16string preloadBase;
+
     // for report
     unsigned windowDepth;
 
@@ -249,6 +304,12 @@ private:
 
     void updateView(ViewCSSImp* next);
 
+    DocumentPtr openDocument();
+    bool canParse();
+    bool parse(const DocumentPtr& document);
+    void setPreloadBase(const std::u16string& documentURI, const Token& token);
+    void preload(const std::u16string& documentURI, const Token& token);
+
 public:
     WindowProxy(unsigned short flags);
     ~WindowProxy();
@@ -107,6 +107,12 @@ unsigned BoxImage::render(ViewCSSImp* view, float x, float y, float width, float
         start = getTick();
     flags |= Rendered;
 
+    // Select the current frame at every repaint.
+    if (1 < frameCount && view->isRecording()) {
+        view->renderLive([=]() { render(view, x, y, width, height, left, top, start); });
+        return start;
+    }
+
     glMatrixMode(GL_TEXTURE);
     glLoadIdentity();
     if (repeat & Clamp)
@@ -141,9 +147,13 @@ unsigned BoxImage::render(ViewCSSImp* view, float x, float y, float width, float
 
     if (width < 0.0f || height < 0.0f)
         return start;
+    if (1 < frameCount)
+        view->addAnimatedImage(x, y, width, height);
 
-    GLuint texname = getTexname(pixels + frame * (naturalWidth * naturalHeight * 4),
-                                naturalWidth, naturalHeight, repeat, format);
+    uint8_t* image = pixels + frame * (naturalWidth * naturalHeight * 4);
+    if (view->isRecording() && texnames.find(image) == texnames.end())
+        view->invalidateDisplayList();  // not to replay the texture upload
+    GLuint texname = getTexname(image, naturalWidth, naturalHeight, repeat, format);
 
     glEnable(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, texname);
@@ -351,6 +361,7 @@ void Box::renderBorder(ViewCSSImp* view, float left, float top,
             if (!style->backgroundAttachment.isFixed())
                 backgroundStart = backgroundImage->render(view, -borderLeft, -borderTop, rr - ll, bb - tt, backgroundLeft, backgroundTop, backgroundStart);
             else {
+                view->disableTiles();
                 float fixedX = left + lr - view->getWindow()->getScrollX();
                 float fixedY = top + tb - view->getWindow()->getScrollY();
                 for (Element element = interface_cast<Element>(getNode()); element; element = element.getParentElement()) {
@@ -362,13 +373,16 @@ void Box::renderBorder(ViewCSSImp* view, float left, float top,
         } else {
             ContainingBlockPtr containingBlock = getContainingBlock(view);
             glTranslatef(lr, tb, 0.0f);
-            float l = -lr + view->getWindow()->getScrollX();
-            float t = -tb + view->getWindow()->getScrollY();
-            float r = containingBlock->width + view->getWindow()->getScrollX();
-            float b = containingBlock->height + view->getWindow()->getScrollY();
+            float areaLeft, areaTop, areaWidth, areaHeight;
+            view->getRenderArea(areaLeft, areaTop, areaWidth, areaHeight);
+            float l = -lr + areaLeft;
+            float t = -tb + areaTop;
+            float r = areaWidth + areaLeft;
+            float b = areaHeight + areaTop;
             if (!style->backgroundAttachment.isFixed())
                 backgroundStart = backgroundImage->render(view, l, t, r, b, backgroundLeft, backgroundTop, backgroundStart);
             else {
+                view->disableTiles();
                 float fixedX = left - l;
                 float fixedY = top - t;
                 backgroundStart = backgroundImage->render(view, l, t, r, b, backgroundLeft - fixedX, backgroundTop - fixedY, backgroundStart);
@@ -544,6 +558,7 @@ unsigned Block::renderBegin(ViewCSSImp* view, bool noBorder)
         float scrollX = 0.0f;
         float scrollY = 0.0f;
         if (isFixed() && style->getParentStyle()) {
+            view->disableTiles();
             glPushMatrix();
             scrollX = view->getWindow()->getScrollX();
             scrollY = view->getWindow()->getScrollY();
@@ -640,7 +655,8 @@ void Block::renderInline(ViewCSSImp* view, StackingContext* stackingContext)
     if (childWindow) {
         glPushMatrix();
         glTranslatef(x + getBlankLeft(), y + getBlankTop(), 0.0f);
-        childWindow->render(view);
+        WindowProxyPtr child = childWindow;
+        view->renderLive([=]() { child->render(view); });
         glPopMatrix();
         return;
     }
@@ -926,7 +942,8 @@ void InlineBox::render(ViewCSSImp* view, StackingContext* stackingContext)
     if (childWindow) {
         glPushMatrix();
         glTranslatef(x + getBlankLeft(), y + getBlankTop(), 0.0f);
-        childWindow->render(view);
+        WindowProxyPtr child = childWindow;
+        view->renderLive([=]() { child->render(view); });
         glPopMatrix();
     } else if (getFirstChild()) { // for inline-block
         if (getFirstChild()->stackingContext == stackingContext)
@@ -993,6 +1010,7 @@ void InlineBox::renderText(ViewCSSImp* view, const std::u16string& data, float p
         letterSpacing = activeStyle->letterSpacing.getPx() * font->getPoint() / point;
     float wordSpacing = activeStyle->wordSpacing.getPx() * font->getPoint() / point;
     unsigned variant = activeStyle->fontVariant.getValue();
+    float x = 0.0f;
     font->beginRender();
     const char16_t* p = data.c_str();
     const char16_t* end = p + data.length();
@@ -1017,21 +1035,16 @@ void InlineBox::renderText(ViewCSSImp* view, const std::u16string& data, float p
             }
         }
         if (caps == u) {
-            currentFont->renderGlyph(glyph);
-            glTranslatef((-glyph->left + glyph->advance) / 64.0f, (glyph->top - currentFont->getBearingGap()) / 64.0f, 0.0f);
+            currentFont->renderGlyph(glyph, x, 0.0f);
+            x += glyph->advance / 64.0f;
         } else {
-            glPushMatrix();
-            glScalef(currentFont->getSmallCapsScale(), currentFont->getSmallCapsScale(), 1.0);
-            currentFont->renderGlyph(glyph);
-            glPopMatrix();
-            glTranslatef(glyph->advance / 64.0f * currentFont->getSmallCapsScale(), 0.0f, 0.0f);
+            float scale = currentFont->getSmallCapsScale();
+            currentFont->renderGlyph(glyph, x, 0.0f, scale);
+            x += glyph->advance / 64.0f * scale;
         }
-        float spacing = 0.0f;
         if (u == ' ' || u == u'\u00A0')  // SP or NBSP
-            spacing += wordSpacing;
-        spacing += letterSpacing;
-        if (spacing != 0.0f)
-            glTranslatef(spacing, 0.0f, 0.0f);
+            x += wordSpacing;
+        x += letterSpacing;
     }
     font->endRender();
 }
@@ -517,8 +517,7 @@ bool CSSAutoNumberingValueImp::setValue(CSSStyleDeclarationImp* self, CSSValuePa
             number = static_cast<int>((*i)->number);
         else
             --i;
-        if (Content* content = new(std::nothrow) Content(name, number))
-            contents.push_back(content);
+        contents.push_back(Content(name, number));
     }
     return true;
 }
@@ -531,7 +530,7 @@ std::u16string CSSAutoNumberingValueImp::getCssText(CSSStyleDeclarationImp* self
     for (auto i = contents.begin(); i != contents.end(); ++i) {
         if (i != contents.begin())
             cssText += u' ';
-        cssText += (*i)->getCssText(defaultNumber);
+        cssText += i->getCssText(defaultNumber);
     }
     return cssText;
 }
@@ -539,12 +538,12 @@ std::u16string CSSAutoNumberingValueImp::getCssText(CSSStyleDeclarationImp* self
 void CSSAutoNumberingValueImp::incrementCounter(ViewCSSImp* view, CounterContext* context)
 {
     for (auto i = contents.begin(); i != contents.end(); ++i) {
-        if (CounterImpPtr counter = view->getCounter((*i)->name)) {
+        if (CounterImpPtr counter = view->getCounter(i->name)) {
             if (counter->empty()) {
                 counter->nest(0);
                 context->addCounter(counter.get());
             }
-            counter->increment((*i)->number);
+            counter->increment(i->number);
         }
     }
 }
@@ -552,11 +551,11 @@ void CSSAutoNumberingValueImp::incrementCounter(ViewCSSImp* view, CounterContext
 void CSSAutoNumberingValueImp::resetCounter(ViewCSSImp* view, CounterContext* context)
 {
     for (auto i = contents.begin(); i != contents.end(); ++i) {
-        if (CounterImpPtr counter = view->getCounter((*i)->name)) {
-            if (context->hasCounter((*i)->name))
-                counter->reset((*i)->number);
+        if (CounterImpPtr counter = view->getCounter(i->name)) {
+            if (context->hasCounter(i->name))
+                counter->reset(i->number);
             else {
-                counter->nest((*i)->number);
+                counter->nest(i->number);
                 context->addCounter(counter.get());
             }
         }
@@ -1193,8 +1192,7 @@ bool CSSContentValueImp::setValue(CSSStyleDeclarationImp* self, CSSValueParser*
                 break;
             }
         }
-        if (content)
-            contents.push_back(content);
+        append(content);
     }
     return true;
 }
@@ -1214,13 +1212,9 @@ std::u16string CSSContentValueImp::getCssText(CSSStyleDeclarationImp* self) cons
 
 void CSSContentValueImp::specify(const CSSContentValueImp& specified)
 {
-    reset();
     original = specified.original;
     value = specified.value;
-    for (auto i = specified.contents.begin(); i != specified.contents.end(); ++i) {
-        if (Content* clone = (*i)->clone())
-            contents.push_back(clone);
-    }
+    contents = specified.contents;
 }
 
 bool CSSContentValueImp::operator==(const CSSContentValueImp& content) const
@@ -1234,6 +1228,8 @@ bool CSSContentValueImp::operator==(const CSSContentValueImp& content) const
     if (isNone() || content.isNone())
         return false;
     assert(!contents.empty() && !content.contents.empty());
+    if (contents.isSharedWith(content.contents))
+        return true;
     if (contents.size() != content.contents.size())
         return false;
     return getCssText() == content.getCssText();    // TODO: Refine
@@ -1246,17 +1242,16 @@ void CSSContentValueImp::compute(ViewCSSImp* view, CSSStyleDeclarationImp* self)
     case CSSPseudoElementSelector::After:
         if (wasNormal()) {
             value = None;
-            clearContents();
+            contents.clear();
         }
         break;
     case CSSPseudoElementSelector::Marker:
         if (wasNormal()) {
             value = None;
-            clearContents();
+            contents.clear();
             // If the image is not valid, use the 'list-style-type' instead.
             if (self->listStyleImage.hasImage()) {
-                if (URIContent* content = new(std::nothrow) URIContent(self->listStyleImage.getValue()))
-                    contents.push_back(content);
+                append(new(std::nothrow) URIContent(self->listStyleImage.getValue()));
             } else {
                 switch (self->listStyleType.getValue()) {
                 case CSSListStyleTypeValueImp::None:
@@ -1264,10 +1259,8 @@ void CSSContentValueImp::compute(ViewCSSImp* view, CSSStyleDeclarationImp* self)
                 case CSSListStyleTypeValueImp::Disc:
                 case CSSListStyleTypeValueImp::Circle:
                 case CSSListStyleTypeValueImp::Square:
-                    if (CounterContent* content = new CounterContent(u"list-item", self->listStyleType.getValue()))
-                        contents.push_back(content);
-                    if (Content* content = new(std::nothrow) StringContent(u"\u00A0"))
-                        contents.push_back(content);
+                    append(new(std::nothrow) CounterContent(u"list-item", self->listStyleType.getValue()));
+                    append(new(std::nothrow) StringContent(u"\u00A0"));
                     break;
                 case CSSListStyleTypeValueImp::Decimal:
                 case CSSListStyleTypeValueImp::DecimalLeadingZero:
@@ -1280,10 +1273,8 @@ void CSSContentValueImp::compute(ViewCSSImp* view, CSSStyleDeclarationImp* self)
                 case CSSListStyleTypeValueImp::Georgian:
                 case CSSListStyleTypeValueImp::LowerAlpha:
                 case CSSListStyleTypeValueImp::UpperAlpha:
-                    if (CounterContent* content = new CounterContent(u"list-item", self->listStyleType.getValue()))
-                        contents.push_back(content);
-                    if (Content* content = new(std::nothrow) StringContent(u".\u00A0"))
-                        contents.push_back(content);
+                    append(new(std::nothrow) CounterContent(u"list-item", self->listStyleType.getValue()));
+                    append(new(std::nothrow) StringContent(u".\u00A0"));
                     break;
                 default:
                     break;
@@ -1344,7 +1335,7 @@ std::u16string CSSContentValueImp::QuoteContent::eval(ViewCSSImp* view, Element
 
 std::u16string CSSContentValueImp::evalText(ViewCSSImp* view, Element element, CounterContext* context)
 {
-    if (!contents.empty() && dynamic_cast<URIContent*>(contents.front()))
+    if (!contents.empty() && dynamic_cast<URIContent*>(contents.front().get()))
         return u"";
 
     std::u16string data;
@@ -1358,7 +1349,7 @@ Element CSSContentValueImp::eval(ViewCSSImp* view, Element element, CounterConte
     if (contents.empty())
         return nullptr;
 
-    if (URIContent* content = dynamic_cast<URIContent*>(contents.front())) {
+    if (URIContent* content = dynamic_cast<URIContent*>(contents.front().get())) {
         html::HTMLImageElement img = interface_cast<html::HTMLImageElement>(view->getDocument()->createElement(u"img"));
         if (img) {
             img.setSrc(content->value);
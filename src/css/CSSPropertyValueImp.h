@@ -27,6 +27,9 @@
 #include <assert.h>  // TODO
 #include <math.h>
 
+#include <memory>
+#include <vector>
+
 #include "CSSValueParser.h"
 #include "CSSSerialize.h"
 #include "http/HTTPRequest.h"
@@ -48,6 +51,59 @@ typedef std::shared_ptr<CSSStyleDeclarationImp> CSSStyleDeclarationPtr;
 typedef std::shared_ptr<LineBox> LineBoxPtr;
 typedef std::shared_ptr<InlineBox> InlineBoxPtr;
 
+// CSSSharedList is a copy-on-write list of values. Specifying or
+// inheriting a list-valued property just shares the list with the
+// other style declaration, and an empty list allocates nothing.
+template<typename T>
+class CSSSharedList
+{
+    typedef std::vector<T> List;
+    std::shared_ptr<List> list;
+
+    static const List& getEmptyList() {
+        static const List empty;
+        return empty;
+    }
+    const List& get() const {
+        return list ? *list : getEmptyList();
+    }
+
+public:
+    typedef typename List::const_iterator const_iterator;
+
+    const_iterator begin() const {
+        return get().begin();
+    }
+    const_iterator end() const {
+        return get().end();
+    }
+    size_t size() const {
+        return get().size();
+    }
+    bool empty() const {
+        return !list || list->empty();
+    }
+    const T& front() const {
+        return get().front();
+    }
+    const T& operator[](size_t i) const {
+        return get()[i];
+    }
+    void clear() {
+        list.reset();
+    }
+    void push_back(const T& value) {
+        if (!list)
+            list = std::make_shared<List>();
+        else if (!list.unique())
+            list = std::make_shared<List>(*list);
+        list->push_back(value);
+    }
+    bool isSharedWith(const CSSSharedList& other) const {
+        return list == other.list;
+    }
+};
+
 struct CSSNumericValue
 {
     static const char16_t* Units[];
@@ -632,9 +688,6 @@ public:
                 return CSSSerializeIdentifier(name);
             return CSSSerializeIdentifier(name) + u' ' + CSSSerializeInteger(number);
         }
-        Content* clone() {
-            return new(std::nothrow) Content(name, number);
-        }
     };
 
     struct CounterContext
@@ -657,23 +710,12 @@ public:
 
 
 private:
-    std::list<Content*> contents;
+    CSSSharedList<Content> contents;
     int defaultNumber;
 
-    void clearContents() {
-        while (!contents.empty()) {
-            Content* content = contents.front();
-            delete content;
-            contents.pop_front();
-        }
-    }
-
 public:
-    virtual ~CSSAutoNumberingValueImp() {
-        clearContents();
-    }
     void reset() {
-        clearContents();
+        contents.clear();
     }
     virtual bool setValue(CSSStyleDeclarationImp* self, CSSValueParser* parser);
     virtual std::u16string getCssText(CSSStyleDeclarationImp* decl = 0) const;
@@ -682,11 +724,7 @@ public:
         return !(*this == other);
     }
     void specify(const CSSAutoNumberingValueImp& specified) {
-        reset();
-        for (auto i = specified.contents.begin(); i != specified.contents.end(); ++i) {
-            if (Content* clone = (*i)->clone())
-                contents.push_back(clone);
-        }
+        contents = specified.contents;
     }
     bool hasCounter() const {
         return !contents.empty();
@@ -1280,7 +1318,6 @@ public:
         virtual std::u16string eval(ViewCSSImp* view, Element element, CounterContext* context) {
             return u"";
         }
-        virtual Content* clone() = 0;
     };
     struct StringContent : public Content {
         std::u16string value;
@@ -1293,9 +1330,6 @@ public:
         virtual std::u16string eval(ViewCSSImp* view, Element element, CounterContext* context) {
             return value;
         }
-        virtual StringContent* clone() {
-            return new(std::nothrow) StringContent(value);
-        }
     };
     struct URIContent : public Content {
         std::u16string value;
@@ -1305,9 +1339,6 @@ public:
         virtual std::u16string getCssText() const {
             return u"url(" + CSSSerializeString(value) + u')';
         }
-        virtual URIContent* clone() {
-            return new(std::nothrow) URIContent(value);
-        }
     };
     struct CounterContent : public Content {
         std::u16string identifier;
@@ -1331,12 +1362,6 @@ public:
             return u"counter(" +  CSSSerializeIdentifier(identifier) + u", " + listStyleType.getCssText() + u')';
         }
         virtual std::u16string eval(ViewCSSImp* view, Element element, CounterContext* context);
-        virtual CounterContent* clone() {
-            if (nested)
-                return new(std::nothrow) CounterContent(identifier, string, listStyleType.getValue());
-            else
-                return new(std::nothrow) CounterContent(identifier, listStyleType.getValue());
-        }
     };
     struct AttrContent : public Content {
         std::u16string identifier;
@@ -1347,9 +1372,6 @@ public:
             return u"attr(" + CSSSerializeIdentifier(identifier) + u')';
         }
         virtual std::u16string eval(ViewCSSImp* view, Element element, CounterContext* context);
-        virtual AttrContent* clone() {
-            return new(std::nothrow) AttrContent(identifier);
-        }
     };
     struct QuoteContent : public Content {
         unsigned value;
@@ -1360,31 +1382,22 @@ public:
             return CSSContentValueImp::Options[value];
         }
         virtual std::u16string eval(ViewCSSImp* view, Element element, CounterContext* context);
-        virtual QuoteContent* clone() {
-            return new(std::nothrow) QuoteContent(value);
-        }
     };
 
-    void clearContents() {
-        while (!contents.empty()) {
-            Content* content = contents.front();
-            delete content;
-            contents.pop_front();
-        }
+    void append(Content* content) {
+        if (content)
+            contents.push_back(std::shared_ptr<Content>(content));
     }
 
 protected:
     unsigned original;
     unsigned value;  // Normal or None; ignore this value if contents is not empty.
-    std::list<Content*> contents;
+    CSSSharedList<std::shared_ptr<Content>> contents;
 
 public:
-    ~CSSContentValueImp() {
-        clearContents();
-    }
     void reset() {
         original = value = Normal;
-        clearContents();
+        contents.clear();
     }
     virtual bool setValue(CSSStyleDeclarationImp* self, CSSValueParser* parser);
 
@@ -1780,7 +1793,7 @@ public:
 class CSSFontFamilyValueImp : public CSSPropertyValueImp
 {
     unsigned generic;
-    std::list<std::u16string> familyNames;
+    CSSSharedList<std::u16string> familyNames;
 public:
     enum {
         None,
@@ -1806,6 +1819,8 @@ public:
     bool operator==(const CSSFontFamilyValueImp& value) const {
         if (generic != value.generic)
             return false;
+        if (familyNames.isSharedWith(value.familyNames))
+            return true;
         if (familyNames.size() != value.familyNames.size())
             return false;
         auto j = value.familyNames.begin();
@@ -1825,7 +1840,7 @@ public:
     unsigned getGeneric() const {
         return generic;
     }
-    const std::list<std::u16string>& getFamilyNames() const {
+    const CSSSharedList<std::u16string>& getFamilyNames() const {
         return familyNames;
     }
     CSSFontFamilyValueImp() :
@@ -2413,7 +2428,7 @@ public:
 
 class CSSQuotesValueImp : public CSSPropertyValueImp
 {
-    std::deque<std::pair<std::u16string, std::u16string>> quotes;
+    CSSSharedList<std::pair<std::u16string, std::u16string>> quotes;
 public:
     enum {
         None = 0,
@@ -2422,10 +2437,12 @@ public:
     virtual bool setValue(CSSStyleDeclarationImp* self, CSSValueParser* parser);
     virtual std::u16string getCssText(CSSStyleDeclarationImp* self) const;
     bool operator==(const CSSQuotesValueImp& value) const {
+        if (quotes.isSharedWith(value.quotes))
+            return true;
         if (quotes.size() != value.quotes.size())
             return false;
         auto j = value.quotes.begin();
-        for (auto i = quotes.begin(); i != quotes.end(); ++i) {
+        for (auto i = quotes.begin(); i != quotes.end(); ++i, ++j) {
             if (i->first != j->first || i->second != j->second)
                 return false;
         }
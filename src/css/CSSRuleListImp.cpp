@@ -21,6 +21,7 @@
 #include "CSSStyleSheetImp.h"
 
 #include "DocumentImp.h"
+#include "ElementImp.h"
 #include "ViewCSSImp.h"
 
 #include "html/MediaQueryListImp.h"
@@ -54,17 +55,17 @@ void CSSRuleListImp::appendMisc(CSSSelector* selector, const CSSStyleDeclaration
 
 void CSSRuleListImp::appendID(CSSSelector* selector, const CSSStyleDeclarationPtr& declaration, const std::u16string& key, const MediaListPtr& mediaList)
 {
-    mapID.insert(std::pair<std::u16string, Rule>(key, Rule{ selector, declaration.get(), ++order, mediaList.get() }));
+    mapID.insert(std::pair<Atom, Rule>(Atom(key), Rule{ selector, declaration.get(), ++order, mediaList.get() }));
 }
 
 void CSSRuleListImp::appendClass(CSSSelector* selector, const CSSStyleDeclarationPtr& declaration, const std::u16string& key, const MediaListPtr& mediaList)
 {
-    mapClass.insert(std::pair<std::u16string, Rule>(key, Rule{ selector, declaration.get(), ++order, mediaList.get() }));
+    mapClass.insert(std::pair<Atom, Rule>(Atom(key), Rule{ selector, declaration.get(), ++order, mediaList.get() }));
 }
 
 void CSSRuleListImp::appendType(CSSSelector* selector, const CSSStyleDeclarationPtr& declaration, const std::u16string& key, const MediaListPtr& mediaList)
 {
-    mapType.insert(std::pair<std::u16string, Rule>(key, Rule{ selector, declaration.get(), ++order, mediaList.get() }));
+    mapType.insert(std::pair<Atom, Rule>(Atom(key), Rule{ selector, declaration.get(), ++order, mediaList.get() }));
 }
 
 void CSSRuleListImp::append(css::CSSRule rule, const DocumentPtr& document, const MediaListPtr& mediaList)
@@ -77,6 +78,8 @@ void CSSRuleListImp::append(css::CSSRule rule, const DocumentPtr& document, cons
                 CSSSelector* selector = *j;
                 auto declaration = std::dynamic_pointer_cast<CSSStyleDeclarationImp>(styleRule->getStyle().self());
                 selector->registerToRuleList(this, declaration, mediaList);
+                if (selector->isSiblingDependent())
+                    siblingDependent = true;
             }
         }
     } else if (auto mediaRule = std::dynamic_pointer_cast<CSSMediaRuleImp>(rule.self())) {
@@ -97,9 +100,12 @@ void CSSRuleListImp::append(css::CSSRule rule, const DocumentPtr& document, cons
         ruleList.push_back(rule);
 }
 
-void CSSRuleListImp::collectRules(RuleSet& set, ViewCSSImp* view, Element& element, std::multimap<std::u16string, Rule>& map, const std::u16string& key, MediaListPtr mediaList)
+void CSSRuleListImp::collectRules(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, RuleMap& map, const Atom& key, MediaListPtr mediaList)
 {
-    for (auto i = map.find(key); i != map.end() && i->first == key; ++i) {
+    if (!key)
+        return;
+    auto range = map.equal_range(key);
+    for (auto i = range.first; i != range.second; ++i) {
         CSSSelector* selector = i->second.selector;
         if (!selector->match(element, view, false))
             continue;
@@ -112,15 +118,27 @@ void CSSRuleListImp::collectRules(RuleSet& set, ViewCSSImp* view, Element& eleme
     }
 }
 
-void CSSRuleListImp::collectRulesByID(RuleSet& set, ViewCSSImp* view, Element& element, const MediaListPtr& mediaList)
+void CSSRuleListImp::collectRulesByID(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, const MediaListPtr& mediaList)
 {
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(element.self())) {
+        collectRules(set, view, element, importance, mapID, imp->getIdAtom(), mediaList);
+        return;
+    }
     Nullable<std::u16string> attr = element.getAttribute(u"id");
     if (attr.hasValue())
-        collectRules(set, view, element, mapID, attr.value(), mediaList);
+        collectRules(set, view, element, importance, mapID, Atom::find(attr.value()), mediaList);
 }
 
-void CSSRuleListImp::collectRulesByClass(RuleSet& set, ViewCSSImp* view, Element& element, const MediaListPtr& mediaList)
+void CSSRuleListImp::collectRulesByClass(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, const MediaListPtr& mediaList)
 {
+    if (mapClass.empty())
+        return;
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(element.self())) {
+        const std::vector<Atom>& classes = imp->getClassAtoms();
+        for (auto i = classes.begin(); i != classes.end(); ++i)
+            collectRules(set, view, element, importance, mapClass, *i, mediaList);
+        return;
+    }
     Nullable<std::u16string> attr = element.getAttribute(u"class");
     if (attr.hasValue()) {
         std::u16string classes = attr.value();
@@ -132,17 +150,20 @@ void CSSRuleListImp::collectRulesByClass(RuleSet& set, ViewCSSImp* view, Element
             size_t start = pos++;
             while (pos < classes.length() && !isSpace(classes[pos]))
                 ++pos;
-            collectRules(set, view, element, mapClass, classes.substr(start, pos - start), mediaList);
+            collectRules(set, view, element, importance, mapClass, Atom::find(classes.substr(start, pos - start)), mediaList);
         }
     }
 }
 
-void CSSRuleListImp::collectRulesByType(RuleSet& set, ViewCSSImp* view, Element& element, const MediaListPtr& mediaList)
+void CSSRuleListImp::collectRulesByType(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, const MediaListPtr& mediaList)
 {
-    collectRules(set, view, element, mapType, element.getLocalName(), mediaList);
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(element.self()))
+        collectRules(set, view, element, importance, mapType, imp->getLocalNameAtom(), mediaList);
+    else
+        collectRules(set, view, element, importance, mapType, Atom::find(element.getLocalName()), mediaList);
 }
 
-void CSSRuleListImp::collectRulesByMisc(RuleSet& set, ViewCSSImp* view, Element& element, MediaListPtr mediaList)
+void CSSRuleListImp::collectRulesByMisc(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, MediaListPtr mediaList)
 {
     for (auto i = misc.begin(); i != misc.end(); ++i) {
         CSSSelector* selector = i->selector;
@@ -159,8 +180,6 @@ void CSSRuleListImp::collectRulesByMisc(RuleSet& set, ViewCSSImp* view, Element&
 
 void CSSRuleListImp::collectRules(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, MediaListPtr mediaList)
 {
-    this->importance = importance;
-
     // Declarations in imported style sheets are considered to be before any
     // declarations in the style sheet itself.
     // cf. http://www.w3.org/TR/CSS2/cascade.html#cascading-order
@@ -169,15 +188,15 @@ void CSSRuleListImp::collectRules(RuleSet& set, ViewCSSImp* view, Element& eleme
             mediaList = media;
         // TODO: else ...
         if (auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>((*i)->getStyleSheet().self())) {
-            if (auto ruleList = std::dynamic_pointer_cast<CSSRuleListImp>(sheet->getCssRules().self()))
+            if (auto ruleList = std::dynamic_pointer_cast<CSSRuleListImp>(sheet->getRules().self()))
                 ruleList->collectRules(set, view, element, importance, mediaList);
         }
     }
 
-    collectRulesByMisc(set, view, element, mediaList);
-    collectRulesByType(set, view, element, mediaList);
-    collectRulesByClass(set, view, element, mediaList);
-    collectRulesByID(set, view, element, mediaList);
+    collectRulesByMisc(set, view, element, importance, mediaList);
+    collectRulesByType(set, view, element, importance, mediaList);
+    collectRulesByClass(set, view, element, importance, mediaList);
+    collectRulesByID(set, view, element, importance, mediaList);
 }
 
 bool CSSRuleListImp::hasHover(const RuleSet& set)
@@ -190,4 +209,43 @@ bool CSSRuleListImp::hasHover(const RuleSet& set)
     return false;
 }
 
+bool CSSRuleListImp::isSiblingDependent()
+{
+    if (siblingDependent)
+        return true;
+    for (auto i = importList.begin(); i != importList.end(); ++i) {
+        if (auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>((*i)->getStyleSheet().self())) {
+            if (auto ruleList = std::dynamic_pointer_cast<CSSRuleListImp>(sheet->getRules().self())) {
+                if (ruleList->isSiblingDependent())
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+void CSSRuleListImp::addFeature(int feature, const std::u16string& name, unsigned position)
+{
+    assert(0 <= feature && feature < MaxFeatures);
+    features[feature][Atom(name)] |= position;
+}
+
+unsigned CSSRuleListImp::getFeature(int feature, const Atom& name)
+{
+    assert(0 <= feature && feature < MaxFeatures);
+    unsigned position = 0;
+    if (!name)
+        return position;
+    auto found = features[feature].find(name);
+    if (found != features[feature].end())
+        position = found->second;
+    for (auto i = importList.begin(); i != importList.end(); ++i) {
+        if (auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>((*i)->getStyleSheet().self())) {
+            if (auto ruleList = std::dynamic_pointer_cast<CSSRuleListImp>(sheet->getRules().self()))
+                position |= ruleList->getFeature(feature, name);
+        }
+    }
+    return position;
+}
+
 }}}}  // org::w3c::dom::bootstrap
@@ -23,11 +23,15 @@
 
 #include <org/w3c/dom/css/CSSRuleList.h>
 
+#include <algorithm>
 #include <deque>
 #include <list>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
+#include "Atom.h"
 #include "CSSImportRuleImp.h"
 #include "CSSStyleRuleImp.h"
 
@@ -107,30 +111,98 @@ public:
         }
     };
 
-    typedef std::multiset<PrioritizedRule> RuleSet;
+    // RuleSet keeps the matched rules sorted by their priority and order
+    // in a flat array. A rule is inserted after the equivalent rules as in
+    // std::multiset, but the whole set takes only a single allocation in
+    // most cases. The allocator of the array can be replaced to count the
+    // allocations.
+    template<class Allocator = std::allocator<PrioritizedRule>>
+    class BasicRuleSet
+    {
+        static const size_t InitialCapacity = 16;
+
+        std::vector<PrioritizedRule, Allocator> rules;
+
+    public:
+        typedef typename std::vector<PrioritizedRule, Allocator>::const_iterator const_iterator;
+        typedef const_iterator iterator;
+
+        void insert(const PrioritizedRule& rule) {
+            if (rules.empty())
+                rules.reserve(InitialCapacity);
+            if (rules.empty() || !(rule < rules.back()))
+                rules.push_back(rule);
+            else
+                rules.insert(std::upper_bound(rules.begin(), rules.end(), rule), rule);
+        }
+        // Keeps the allocated array for the next selector matching.
+        void clear() {
+            rules.clear();
+        }
+        void swap(BasicRuleSet& other) {
+            rules.swap(other.rules);
+        }
+        bool empty() const {
+            return rules.empty();
+        }
+        size_t size() const {
+            return rules.size();
+        }
+        const_iterator begin() const {
+            return rules.begin();
+        }
+        const_iterator end() const {
+            return rules.end();
+        }
+    };
+    typedef BasicRuleSet<> RuleSet;
+
+    // Kinds of names referenced by the selectors
+    enum Feature
+    {
+        ClassFeature,
+        IDFeature,
+        AttributeFeature,
+
+        MaxFeatures
+    };
+
+    // Where a referenced name appears in a selector, as a bit mask
+    enum FeaturePosition
+    {
+        Subject = 1,    // in the rightmost compound selector
+        Ancestor = 2,   // on the left of a descendant or child combinator
+        Sibling = 4     // on the left of a sibling combinator
+    };
 
 private:
-    unsigned importance;
     unsigned order;
+    bool siblingDependent;  // true if any selector depends on the siblings of an element
     std::deque<css::CSSRule> ruleList;
 
     std::deque<CSSImportRulePtr> importList;
-    std::multimap<std::u16string, Rule> mapID;     // ID selectors
-    std::multimap<std::u16string, Rule> mapClass;  // class selectors
-    std::multimap<std::u16string, Rule> mapType;   // type selectors
+    typedef std::unordered_multimap<Atom, Rule> RuleMap;
+
+    RuleMap mapID;      // ID selectors
+    RuleMap mapClass;   // class selectors
+    RuleMap mapType;    // type selectors
     std::deque<Rule> misc;
 
+    std::unordered_map<Atom, unsigned> features[MaxFeatures];
+
     // TODO: avoid using non-const MediaListPtr reference
-    void collectRules(RuleSet& set, ViewCSSImp* view, Element& element, std::multimap<std::u16string, Rule>& map, const std::u16string& key, MediaListPtr mediaList);
-    void collectRulesByID(RuleSet& set, ViewCSSImp* view, Element& element, const MediaListPtr& mediaList);
-    void collectRulesByClass(RuleSet& set, ViewCSSImp* view, Element& element, const MediaListPtr& mediaList);
-    void collectRulesByType(RuleSet& set, ViewCSSImp* view, Element& element, const MediaListPtr& mediaList);
-    void collectRulesByMisc(RuleSet& set, ViewCSSImp* view, Element& element, MediaListPtr mediaList);
+    // The rule lists are shared by the selector matching threads; these
+    // must not modify CSSRuleListImp.
+    void collectRules(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, RuleMap& map, const Atom& key, MediaListPtr mediaList);
+    void collectRulesByID(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, const MediaListPtr& mediaList);
+    void collectRulesByClass(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, const MediaListPtr& mediaList);
+    void collectRulesByType(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, const MediaListPtr& mediaList);
+    void collectRulesByMisc(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, MediaListPtr mediaList);
 
 public:
     CSSRuleListImp() :
-        importance(0),
-        order(0)
+        order(0),
+        siblingDependent(false)
     {}
 
     void append(css::CSSRule rule);   // trivial version for CSSMediaRule
@@ -142,6 +214,15 @@ public:
     void appendType(CSSSelector* selector, const CSSStyleDeclarationPtr& declaration, const std::u16string& key, const MediaListPtr& mediaList);
 
     void collectRules(RuleSet& set, ViewCSSImp* view, Element& element, unsigned importance, MediaListPtr mediaList);
+    bool isSiblingDependent();
+    bool hasImports() const {
+        return !importList.empty();
+    }
+
+    void addFeature(int feature, const std::u16string& name, unsigned position);
+    // Returns the FeaturePosition bits of name in the selectors, including
+    // those in the imported style sheets; 0 if name is not referenced at all.
+    unsigned getFeature(int feature, const Atom& name);
 
     css::CSSRuleList getCssRules() {
         return self();
@@ -23,6 +23,7 @@
 
 #include "CSSStyleDeclarationImp.h"
 #include "CSSRuleListImp.h"
+#include "ElementImp.h"
 #include "ViewCSSImp.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
@@ -152,7 +153,8 @@ CSSSpecificity CSSSelector::getSpecificity()
 bool CSSPrimarySelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 {
     if (name != u"*") {
-        if (e.getLocalName() != name)
+        auto imp = localName ? std::dynamic_pointer_cast<ElementImp>(e.self()) : nullptr;
+        if (imp ? imp->getLocalNameAtom() != localName : e.getLocalName() != name)
             return false;
         if (namespacePrefix != u"*") {
             if (!e.getNamespaceURI().hasValue() || e.getNamespaceURI().value() != namespacePrefix)
@@ -168,6 +170,8 @@ bool CSSPrimarySelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 
 bool CSSIDSelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 {
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(e.self()))
+        return imp->getIdAtom() == atom;
     Nullable<std::u16string> id = e.getAttribute(u"id");
     if (!id.hasValue())
         return false;
@@ -176,6 +180,8 @@ bool CSSIDSelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 
 bool CSSClassSelector::match(Element& e, ViewCSSImp* view, bool dynamic)
 {
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(e.self()))
+        return imp->hasClass(atom);
     Nullable<std::u16string> classes = e.getAttribute(u"class");
     if (!classes.hasValue())
         return false;
@@ -225,6 +231,13 @@ bool CSSSelector::match(Element& element, ViewCSSImp* view, bool dynamic)
     if (!element || simpleSelectors.size() == 0)
         return false;
 
+    if (!dynamic && ancestorHashCount && view) {
+        if (AncestorFilter* filter = view->getAncestorFilter()) {
+            if (!filter->mayContain(ancestorHashes, ancestorHashCount))
+                return false;
+        }
+    }
+
     auto i = simpleSelectors.rbegin();
     if (!(*i)->match(element, view, dynamic))
         return false;
@@ -232,6 +245,10 @@ bool CSSSelector::match(Element& element, ViewCSSImp* view, bool dynamic)
     ++i;
     Element e = element;
     while (i != simpleSelectors.rend()) {
+        if (view && (combinator == CSSPrimarySelector::AdjacentSibling || combinator == CSSPrimarySelector::GeneralSibling)) {
+            if (StyleSharingCache* cache = view->getStyleSharingCache())
+                cache->setUnsharable();
+        }
         switch (combinator) {
         case CSSPrimarySelector::Descendant:
             while (e = e.getParentElement()) {  // TODO: do we need to retry from here upon failure?
@@ -286,12 +303,16 @@ bool CSSPseudoClassSelector::match(Element& element, ViewCSSImp* view, bool dyna
             // It it the responsibility of the reflow and repaint operation to actually
             // check the status of each element.
             if (view)
-                view->hoverList.push_back(element);
+                view->getHoverList().push_back(element);
             return true;
         } else if (view)
             return view->isHovered(element);
         break;
     case FirstChild:
+        if (view) {
+            if (StyleSharingCache* cache = view->getStyleSharingCache())
+                cache->setUnsharable();
+        }
         if (element.getParentElement().getFirstElementChild() == element)
             return true;
         break;
@@ -374,13 +395,168 @@ bool CSSSelector::hasPseudoClassSelector(int type) const
     return false;
 }
 
+bool CSSSelector::isSiblingDependent() const
+{
+    for (auto i = simpleSelectors.begin(); i != simpleSelectors.end(); ++i) {
+        switch ((*i)->getCombinator()) {
+        case CSSPrimarySelector::AdjacentSibling:
+        case CSSPrimarySelector::GeneralSibling:
+            return true;
+        default:
+            break;
+        }
+    }
+    return hasPseudoClassSelector(CSSPseudoClassSelector::FirstChild);
+}
+
 void CSSSelector::registerToRuleList(CSSRuleListImp* ruleList, const CSSStyleDeclarationPtr& declaration, const MediaListPtr& mediaList)
 {
     if (simpleSelectors.empty())
         return;
+    computeAncestorHashes();
+    for (auto i = simpleSelectors.begin(); i != simpleSelectors.end(); ++i) {
+        (*i)->internName();
+        unsigned position = CSSRuleListImp::Subject;
+        auto next = i + 1;
+        if (next != simpleSelectors.end()) {
+            switch ((*next)->getCombinator()) {
+            case CSSPrimarySelector::AdjacentSibling:
+            case CSSPrimarySelector::GeneralSibling:
+                position = CSSRuleListImp::Sibling;
+                break;
+            default:
+                position = CSSRuleListImp::Ancestor;
+                break;
+            }
+        }
+        (*i)->registerFeatures(ruleList, position);
+    }
     simpleSelectors.back()->registerToRuleList(ruleList, this, declaration, mediaList);
 }
 
+void CSSSelector::computeAncestorHashes()
+{
+    ancestorHashCount = 0;
+    auto i = simpleSelectors.rbegin();
+    int combinator = (*i)->getCombinator();
+    for (++i; i != simpleSelectors.rend() && ancestorHashCount < MaxAncestorHashes; ++i) {
+        // An element matching a compound selector on the left of a
+        // descendant or child combinator is always an ancestor of the
+        // matching element, even past sibling combinators.
+        if (combinator == CSSPrimarySelector::Descendant || combinator == CSSPrimarySelector::Child)
+            ancestorHashCount = (*i)->getAncestorHashes(ancestorHashes, ancestorHashCount, MaxAncestorHashes);
+        combinator = (*i)->getCombinator();
+    }
+}
+
+unsigned CSSPrimarySelector::getAncestorHashes(unsigned* hashes, unsigned count, unsigned max) const
+{
+    for (auto i = chain.begin(); i != chain.end() && count < max; ++i) {
+        if (dynamic_cast<CSSIDSelector*>(*i))
+            hashes[count++] = AncestorFilter::getHash((*i)->getName(), AncestorFilter::IDSalt);
+    }
+    for (auto i = chain.begin(); i != chain.end() && count < max; ++i) {
+        if (dynamic_cast<CSSClassSelector*>(*i))
+            hashes[count++] = AncestorFilter::getHash((*i)->getName(), AncestorFilter::ClassSalt);
+    }
+    if (name != u"*" && count < max)
+        hashes[count++] = AncestorFilter::getHash(name, AncestorFilter::TagSalt);
+    return count;
+}
+
+unsigned AncestorFilter::getHash(const std::u16string& s, unsigned salt)
+{
+    // FNV-1a
+    unsigned hash = 2166136261u ^ salt;
+    for (auto i = s.begin(); i != s.end(); ++i) {
+        hash ^= *i;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+AncestorFilter::AncestorFilter()
+{
+    memset(counters, 0, sizeof counters);
+}
+
+void AncestorFilter::add(unsigned hash)
+{
+    hashes.push_back(hash);
+    for (unsigned key : { hash & KeyMask, (hash >> KeyBits) & KeyMask }) {
+        if (counters[key] < 255)
+            ++counters[key];
+    }
+}
+
+void AncestorFilter::remove(unsigned hash)
+{
+    for (unsigned key : { hash & KeyMask, (hash >> KeyBits) & KeyMask }) {
+        // A saturated counter is kept as it is.
+        if (counters[key] < 255)
+            --counters[key];
+    }
+}
+
+void AncestorFilter::push(Element element)
+{
+    frames.push_back(hashes.size());
+    add(getHash(element.getLocalName(), TagSalt));
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(element.self())) {
+        if (imp->getIdAtom())
+            add(getHash(imp->getIdAtom().toString(), IDSalt));
+        const std::vector<Atom>& classes = imp->getClassAtoms();
+        for (auto i = classes.begin(); i != classes.end(); ++i)
+            add(getHash(i->toString(), ClassSalt));
+        return;
+    }
+    Nullable<std::u16string> id = element.getAttribute(u"id");
+    if (id.hasValue())
+        add(getHash(id.value(), IDSalt));
+    Nullable<std::u16string> attr = element.getAttribute(u"class");
+    if (attr.hasValue()) {
+        std::u16string classes = attr.value();
+        for (size_t pos = 0; pos < classes.length();) {
+            if (isSpace(classes[pos])) {
+                ++pos;
+                continue;
+            }
+            size_t start = pos++;
+            while (pos < classes.length() && !isSpace(classes[pos]))
+                ++pos;
+            add(getHash(classes.substr(start, pos - start), ClassSalt));
+        }
+    }
+}
+
+void AncestorFilter::pop()
+{
+    assert(!frames.empty());
+    for (size_t i = frames.back(); i < hashes.size(); ++i)
+        remove(hashes[i]);
+    hashes.resize(frames.back());
+    frames.pop_back();
+}
+
+void CSSPrimarySelector::registerFeatures(CSSRuleListImp* ruleList, unsigned position) const
+{
+    for (auto i = chain.begin(); i != chain.end(); ++i) {
+        if (dynamic_cast<CSSIDSelector*>(*i))
+            ruleList->addFeature(CSSRuleListImp::IDFeature, (*i)->getName(), position);
+        else if (dynamic_cast<CSSClassSelector*>(*i))
+            ruleList->addFeature(CSSRuleListImp::ClassFeature, (*i)->getName(), position);
+        else if (dynamic_cast<CSSAttributeSelector*>(*i)) {
+            std::u16string name = (*i)->getName();
+            toLower(name);
+            ruleList->addFeature(CSSRuleListImp::AttributeFeature, name, position);
+        } else if (dynamic_cast<CSSLangPseudoClassSelector*>(*i)) {
+            // :lang() looks up the lang attribute of the ancestors, too.
+            ruleList->addFeature(CSSRuleListImp::AttributeFeature, u"lang", position | CSSRuleListImp::Subject | CSSRuleListImp::Ancestor);
+        } else if ((*i)->hasPseudoClassSelector(CSSPseudoClassSelector::Link))
+            ruleList->addFeature(CSSRuleListImp::AttributeFeature, u"href", position);
+    }
+}
+
 void CSSPrimarySelector::registerToRuleList(CSSRuleListImp* ruleList, CSSSelector* selector, const CSSStyleDeclarationPtr& declaration, const MediaListPtr& mediaList)
 {
     if (chain.empty()) {
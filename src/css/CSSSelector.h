@@ -24,10 +24,12 @@
 #include <cstring>
 #include <deque>
 #include <string>
+#include <vector>
 
 #include <Object.h>
 #include <org/w3c/dom/Element.h>
 
+#include "Atom.h"
 #include "CSSParser.h"
 #include "CSSSerialize.h"
 #include "utf.h"
@@ -128,6 +130,7 @@ private:
     int combinator;
     std::u16string namespacePrefix;  // IDENT, '*', or empty
     std::deque<CSSSimpleSelector*> chain;
+    Atom localName;  // set by internName()
 public:
     CSSPrimarySelector() :
         CSSSimpleSelector(u"*"),
@@ -153,6 +156,11 @@ public:
     void setNamespacePrefix(const std::u16string& namespacePrefix) {
         this->namespacePrefix = namespacePrefix;
     }
+    // Interns the element name so that match() can compare atoms instead of strings.
+    void internName() {
+        if (name != u"*")
+            localName = Atom(name);
+    }
     int getCombinator() const {
         return combinator;
     }
@@ -167,14 +175,18 @@ public:
     virtual bool hasPseudoClassSelector(int type) const;
     void registerToRuleList(CSSRuleListImp* ruleList, CSSSelector* selector, const CSSStyleDeclarationPtr& declaration, const MediaListPtr& mediaList);
     CSSPseudoElementSelector* getPseudoElement() const;
+    unsigned getAncestorHashes(unsigned* hashes, unsigned count, unsigned max) const;
+    void registerFeatures(CSSRuleListImp* ruleList, unsigned position) const;
 };
 
 // '#' IDENT
 class CSSIDSelector : public CSSSimpleSelector
 {
+    Atom atom;
 public:
     CSSIDSelector(const std::u16string& ident) :
-        CSSSimpleSelector(ident) {
+        CSSSimpleSelector(ident),
+        atom(ident) {
     }
     virtual void serialize(std::u16string& text) {
         text += u'#' + CSSSerializeIdentifier(name);
@@ -191,9 +203,11 @@ public:
 // '.' IDENT
 class CSSClassSelector : public CSSSimpleSelector
 {
+    Atom atom;
 public:
     CSSClassSelector(const std::u16string& ident) :
-        CSSSimpleSelector(ident) {
+        CSSSimpleSelector(ident),
+        atom(ident) {
     }
     virtual void serialize(std::u16string& text) {
         text += u'.' + CSSSerializeIdentifier(name);
@@ -437,11 +451,68 @@ public:
     }
 };
 
+// AncestorFilter is a counting Bloom filter of the tag names, IDs, and
+// classes of the ancestors of the element being matched. It lets selector
+// matching reject most of the descendant selectors without walking up the
+// document tree.
+class AncestorFilter
+{
+    static const unsigned KeyBits = 12;
+    static const unsigned KeyMask = (1u << KeyBits) - 1;
+
+    unsigned char counters[1u << KeyBits];
+    std::vector<unsigned> hashes;
+    std::vector<size_t> frames;
+
+    void add(unsigned hash);
+    void remove(unsigned hash);
+    bool contains(unsigned hash) const {
+        return counters[hash & KeyMask] && counters[(hash >> KeyBits) & KeyMask];
+    }
+
+public:
+    enum {
+        TagSalt = 0x7a9f3c1d,
+        IDSalt = 0x2c5e81b7,
+        ClassSalt = 0x5b134e69
+    };
+    static unsigned getHash(const std::u16string& s, unsigned salt);
+
+    AncestorFilter();
+
+    // Adds element as the innermost ancestor.
+    void push(Element element);
+    // Removes the innermost ancestor.
+    void pop();
+
+    // Returns false if no ancestor can have all of the specified hashes.
+    bool mayContain(const unsigned* hashes, unsigned count) const {
+        for (unsigned i = 0; i < count; ++i) {
+            if (!contains(hashes[i]))
+                return false;
+        }
+        return true;
+    }
+};
+
 class CSSSelector
 {
+public:
+    static const unsigned MaxAncestorHashes = 4;
+
+private:
     std::deque<CSSPrimarySelector*> simpleSelectors;
+
+    // The hashes of the tag names, IDs, and classes that must be found in
+    // the ancestors of the matching element.
+    unsigned ancestorHashes[MaxAncestorHashes];
+    unsigned ancestorHashCount;
+
+    void computeAncestorHashes();
+
 public:
-    CSSSelector(CSSPrimarySelector* simpleSelector) {
+    CSSSelector(CSSPrimarySelector* simpleSelector) :
+        ancestorHashCount(0) {
         simpleSelectors.push_back(simpleSelector);
     }
     void append(int combinator, CSSPrimarySelector* simpleSelector) {
@@ -461,6 +532,8 @@ public:
     bool hasHover() const {
         return hasPseudoClassSelector(CSSPseudoClassSelector::Hover);
     }
+    // Returns true if this selector can match depending on the siblings of an element.
+    bool isSiblingDependent() const;
     void registerToRuleList(CSSRuleListImp* ruleList, const CSSStyleDeclarationPtr& declaration, const MediaListPtr& mediaList);
 };
 
@@ -1754,35 +1754,37 @@ void CSSStyleDeclarationImp::compute(ViewCSSImp* view, const CSSStyleDeclaration
         CSSStyleDeclarationPtr elementDecl;
         if (htmlElement)
             elementDecl = std::dynamic_pointer_cast<CSSStyleDeclarationImp>(htmlElement.getStyle().self());
-        // Normal declarations
+        // Normal declarations. The active rules having important declarations
+        // are kept in the cascading order for the following two passes so that
+        // each rule is tested only once.
+        std::vector<const CSSRuleListImp::PrioritizedRule*> importantRules;
         for (auto i = ruleSet.begin(); i != ruleSet.end(); ++i) {
             if (CSSStyleDeclarationPtr pseudo = createPseudoElementStyle(i->getPseudoElementID())) {
                 if (i->mql)
                     setFlags(MediaDependent);
-                if (i->getMatches() && i->isActive(element, view) && i->getDeclaration())
+                if (i->getMatches() && i->isActive(element, view) && i->getDeclaration()) {
                     pseudo->specify(i->getDeclaration()->getCSSStyleDeclarationPtr());
+                    if (i->getDeclaration()->importantSet.any())
+                        importantRules.push_back(&*i);
+                }
             }
         }
         if (elementDecl)
             specify(elementDecl);
         // Author important declarations
-        for (auto i = ruleSet.begin(); i != ruleSet.end(); ++i) {
-            if (CSSStyleDeclarationPtr pseudo = createPseudoElementStyle(i->getPseudoElementID())) {
-                if (i->mql)
-                    setFlags(MediaDependent);
-                if (i->getMatches() && i->isActive(element, view) && !i->isUserStyle() && i->getDeclaration())
-                    pseudo->specifyImportant(i->getDeclaration()->getCSSStyleDeclarationPtr());
+        for (auto i = importantRules.begin(); i != importantRules.end(); ++i) {
+            if (!(*i)->isUserStyle()) {
+                if (CSSStyleDeclarationPtr pseudo = createPseudoElementStyle((*i)->getPseudoElementID()))
+                    pseudo->specifyImportant((*i)->getDeclaration()->getCSSStyleDeclarationPtr());
             }
         }
         if (elementDecl)
             specifyImportant(elementDecl);
         // User important declarations
-        for (auto i = ruleSet.begin(); i != ruleSet.end(); ++i) {
-            if (CSSStyleDeclarationPtr pseudo = createPseudoElementStyle(i->getPseudoElementID())) {
-                if (i->mql)
-                    setFlags(MediaDependent);
-                if (i->getMatches() && i->isActive(element, view) && i->isUserStyle() && i->getDeclaration())
-                    pseudo->specifyImportant(i->getDeclaration()->getCSSStyleDeclarationPtr());
+        for (auto i = importantRules.begin(); i != importantRules.end(); ++i) {
+            if ((*i)->isUserStyle()) {
+                if (CSSStyleDeclarationPtr pseudo = createPseudoElementStyle((*i)->getPseudoElementID()))
+                    pseudo->specifyImportant((*i)->getDeclaration()->getCSSStyleDeclarationPtr());
             }
         }
     }
@@ -291,7 +291,8 @@ public:
         MediaDependent =        0x1000000,  // This style declaration depends on media queries.
         ComputedStyle =         0x2000000,
         Mutated =               0x4000000,
-        NeedSelectorMatching =  0x8000000
+        NeedSelectorMatching =  0x8000000,
+        NeedSubtreeSelectorMatching = 0x10000000  // The descendants need to be re-matched, too.
     };
 
 private:
@@ -16,6 +16,7 @@
 
 #include "CSSStyleSheetImp.h"
 
+#include "CSSParser.h"
 #include "CSSRuleImp.h"
 #include "ObjectArrayImp.h"
 
@@ -23,12 +24,69 @@ namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
 void CSSStyleSheetImp::append(css::CSSRule rule, const DocumentPtr& document)
 {
+    unshare();
     if (auto imp = std::dynamic_pointer_cast<CSSRuleImp>(rule.self())) {
         imp->setParentStyleSheet(std::static_pointer_cast<CSSStyleSheetImp>(self()));
         ruleList->append(rule, document, 0);
     }
 }
 
+CSSStyleSheetImp::SharedRulesPtr CSSStyleSheetImp::share(const std::u16string& cssText)
+{
+    if (sharedRules)
+        return sharedRules;
+    // The imported style sheets are loaded for each document.
+    if (ruleList->hasImports())
+        return nullptr;
+    auto parentStyleSheet = std::make_shared<CSSStyleSheetImp>();
+    sharedRules = std::make_shared<SharedRules>();
+    if (!parentStyleSheet || !sharedRules) {
+        sharedRules.reset();
+        return nullptr;
+    }
+    parentStyleSheet->setHref(getHref());
+    parentStyleSheet->ruleList = ruleList;
+    parentStyleSheet->adoptRules();
+    sharedRules->ruleList = ruleList;
+    sharedRules->parentStyleSheet = parentStyleSheet;
+    sharedRules->cssText = cssText;
+    return sharedRules;
+}
+
+void CSSStyleSheetImp::setSharedRules(const SharedRulesPtr& rules)
+{
+    assert(rules);
+    sharedRules = rules;
+    ruleList = rules->ruleList;
+}
+
+// Sets this style sheet as the parent style sheet of the rules.
+void CSSStyleSheetImp::adoptRules()
+{
+    for (unsigned i = 0; i < ruleList->getLength(); ++i) {
+        if (auto imp = std::dynamic_pointer_cast<CSSRuleImp>(ruleList->item(i).self()))
+            imp->setParentStyleSheet(std::static_pointer_cast<CSSStyleSheetImp>(self()));
+    }
+}
+
+// Replaces the shared rules with a private copy parsed from the source text.
+void CSSStyleSheetImp::unshare()
+{
+    if (!sharedRules)
+        return;
+    SharedRulesPtr rules(sharedRules);
+    sharedRules.reset();
+    if (rules.use_count() == 1) {  // no other style sheet shares the rules
+        adoptRules();
+        return;
+    }
+    std::u16string href = getHref();
+    CSSParser parser(href);
+    auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>(parser.parse(nullptr, rules->cssText).self());
+    ruleList = sheet ? sheet->ruleList : std::make_shared<CSSRuleListImp>();
+    adoptRules();
+}
+
 // StyleSheet
 std::u16string CSSStyleSheetImp::getType()
 {
@@ -44,16 +102,20 @@ css::CSSRule CSSStyleSheetImp::getOwnerRule()
 
 css::CSSRuleList CSSStyleSheetImp::getCssRules()
 {
+    // The rules can be modified through the returned list.
+    unshare();
     return ruleList;
 }
 
 unsigned int CSSStyleSheetImp::insertRule(const std::u16string& rule, unsigned int index)
 {
+    unshare();
     return ruleList->insertRule(rule, index);
 }
 
 void CSSStyleSheetImp::deleteRule(unsigned int index)
 {
+    unshare();
     ruleList->deleteRule(index);
 }
 
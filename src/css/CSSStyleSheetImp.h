@@ -38,11 +38,46 @@ typedef std::shared_ptr<DocumentImp> DocumentPtr;
 
 class CSSStyleSheetImp : public ObjectMixin<CSSStyleSheetImp, StyleSheetImp>
 {
-    Retained<CSSRuleListImp> ruleList;
+public:
+    // The parsed rules shared by the style sheets loaded from the same
+    // resource. The source text is kept to make a private copy of the
+    // rules before they are exposed to scripts. The shared rules belong to
+    // a style sheet of their own that has no owner node, so that their
+    // relative URLs are resolved against the resource while any document
+    // uses them.
+    struct SharedRules
+    {
+        std::shared_ptr<CSSRuleListImp> ruleList;
+        std::shared_ptr<CSSStyleSheetImp> parentStyleSheet;
+        std::u16string cssText;
+    };
+    typedef std::shared_ptr<SharedRules> SharedRulesPtr;
+
+private:
+    std::shared_ptr<CSSRuleListImp> ruleList;
+    SharedRulesPtr sharedRules;     // non-null while ruleList is shared
+
+    void unshare();
+    void adoptRules();
 
 public:
+    CSSStyleSheetImp() :
+        ruleList(std::make_shared<CSSRuleListImp>())
+    {}
+
     void append(css::CSSRule rule, const DocumentPtr& document);
 
+    // Returns the rules of this style sheet for sharing them with the
+    // other style sheets, or nullptr if they depend on the document.
+    SharedRulesPtr share(const std::u16string& cssText);
+    void setSharedRules(const SharedRulesPtr& rules);
+
+    // Returns the rules for the cascade. Unlike getCssRules(), the rules
+    // can be shared with the other style sheets and must not be modified.
+    std::shared_ptr<CSSRuleListImp> getRules() const {
+        return ruleList;
+    }
+
     // StyleSheet
     virtual std::u16string getType();
 
@@ -24,7 +24,11 @@
 #include <org/w3c/dom/html/HTMLLinkElement.h>
 #include <org/w3c/dom/html/HTMLStyleElement.h>
 
+#include <algorithm>
+#include <cmath>
 #include <new>
+#include <set>
+#include <thread>
 #include <boost/bind.hpp>
 
 #include "CSSImportRuleImp.h"
@@ -63,8 +67,39 @@ BlockPtr getCurrentBox(const CSSStyleDeclarationPtr& style, bool asTablePart)
     return std::dynamic_pointer_cast<TableWrapperBox>(box);
 }
 
+// The state of the thread matching the selectors for view
+struct MatchingThread
+{
+    const ViewCSSImp* view;
+    AncestorFilter* filter;
+    std::list<Element>* hoverList;
+};
+
+__thread MatchingThread* matchingThread;
+
+// Adds the atoms of the class names in value that have already been
+// interned; the other names cannot be referenced by any selector.
+void findClassAtoms(const std::u16string& value, std::set<Atom>& classes)
+{
+    for (size_t pos = 0; pos < value.length();) {
+        if (isSpace(value[pos])) {
+            ++pos;
+            continue;
+        }
+        size_t start = pos++;
+        while (pos < value.length() && !isSpace(value[pos]))
+            ++pos;
+        if (Atom atom = Atom::find(value.substr(start, pos - start)))
+            classes.insert(atom);
+    }
 }
 
+}
+
+unsigned ViewCSSImp::matchingThreads = 0;
+unsigned ViewCSSImp::matchingDepth = 3;
+bool ViewCSSImp::tiledRendering = true;
+
 ViewCSSImp::ViewCSSImp(WindowPtr window) :
     initialContainingBlock(std::make_shared<ContainingBlock>()),
     window(window),
@@ -73,10 +108,24 @@ ViewCSSImp::ViewCSSImp(WindowPtr window) :
     mutationListener(boost::bind(&ViewCSSImp::handleMutation, this, _1, _2)),
     mediaCheck(false),
     overflow(CSSOverflowValueImp::Auto),
+    ancestorFilter(0),
+    styleSharingCache(0),
     stackingContexts(0),
     quotingDepth(0),
     scrollWidth(0.0f),
     scrollHeight(0.0f),
+    displayFontUpdates(0),
+    retainable(false),
+    recording(false),
+    originX(0.0f),
+    originY(0.0f),
+    damage{0.0f, 0.0f, 0.0f, 0.0f},
+    damagedAll(true),
+    tileCanvas(0),
+    tileLeft(0.0f),
+    tileTop(0.0f),
+    retainableTiles(false),
+    tileable(true),
     last(0),
     delay(0)
 {
@@ -91,6 +140,7 @@ ViewCSSImp::ViewCSSImp(WindowPtr window) :
 
 ViewCSSImp::~ViewCSSImp()
 {
+    discardDisplayList();
     if (DocumentPtr document = getDocument()) {
         document->removeEventListener(u"DOMAttrModified", mutationListener, false, EventTargetImp::UseDefault);
         document->removeEventListener(u"DOMCharacterDataModified", mutationListener, false, EventTargetImp::UseDefault);
@@ -135,6 +185,100 @@ void ViewCSSImp::removeComputedStyle(Element element)
     }
 }
 
+bool ViewCSSImp::isSiblingDependent(css::CSSRuleList list)
+{
+    auto ruleList = std::dynamic_pointer_cast<CSSRuleListImp>(list.self());
+    return ruleList && ruleList->isSiblingDependent();
+}
+
+bool ViewCSSImp::isSiblingDependent()
+{
+    if (auto sheet = getDOMImplementation()->getDefaultStyleSheet()) {
+        if (isSiblingDependent(sheet->getRules()))
+            return true;
+    }
+    if (auto sheet = getDOMImplementation()->getUserStyleSheet()) {
+        if (isSiblingDependent(sheet->getRules()))
+            return true;
+    }
+    if (auto sheet = getDOMImplementation()->getPresentationalHints()) {
+        if (isSiblingDependent(sheet->getRules()))
+            return true;
+    }
+    stylesheets::StyleSheetList styleSheetList(getDocument()->getStyleSheets());
+    for (unsigned i = 0; i < styleSheetList.getLength(); ++i) {
+        auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>(styleSheetList.getElement(i).self());
+        if (sheet && isSiblingDependent(sheet->getRules()))
+            return true;
+    }
+    return false;
+}
+
+// Requests a selector re-matching for the elements after element that
+// could be matched through sibling combinators or :first-child.
+void ViewCSSImp::requestSiblingMatching(Element element)
+{
+    if (!isSiblingDependent())
+        return;
+    for (Element e = element.getNextElementSibling(); e; e = e.getNextElementSibling()) {
+        if (CSSStyleDeclarationPtr style = getStyle(e))
+            style->setFlags(CSSStyleDeclarationImp::NeedSelectorMatching | CSSStyleDeclarationImp::NeedSubtreeSelectorMatching);
+    }
+}
+
+unsigned ViewCSSImp::getFeature(css::CSSRuleList list, int feature, const Atom& name)
+{
+    auto ruleList = std::dynamic_pointer_cast<CSSRuleListImp>(list.self());
+    return ruleList ? ruleList->getFeature(feature, name) : 0;
+}
+
+unsigned ViewCSSImp::getFeature(int feature, const Atom& name)
+{
+    unsigned position = 0;
+    if (!name)
+        return position;
+    if (auto sheet = getDOMImplementation()->getDefaultStyleSheet())
+        position |= getFeature(sheet->getRules(), feature, name);
+    if (auto sheet = getDOMImplementation()->getUserStyleSheet())
+        position |= getFeature(sheet->getRules(), feature, name);
+    if (auto sheet = getDOMImplementation()->getPresentationalHints())
+        position |= getFeature(sheet->getRules(), feature, name);
+    stylesheets::StyleSheetList styleSheetList(getDocument()->getStyleSheets());
+    for (unsigned i = 0; i < styleSheetList.getLength(); ++i) {
+        auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>(styleSheetList.getElement(i).self());
+        if (sheet)
+            position |= getFeature(sheet->getRules(), feature, name);
+    }
+    return position;
+}
+
+// Returns the CSSRuleListImp::FeaturePosition bits of the selectors that
+// could change their matching results by the attribute modification.
+unsigned ViewCSSImp::getAttributeFeature(const std::u16string& name, const std::u16string& prevValue, const std::u16string& newValue)
+{
+    std::u16string attrName(name);
+    toLower(attrName);
+    unsigned position = getFeature(CSSRuleListImp::AttributeFeature, Atom::find(attrName));
+    if (attrName == u"id") {
+        position |= getFeature(CSSRuleListImp::IDFeature, Atom::find(prevValue));
+        position |= getFeature(CSSRuleListImp::IDFeature, Atom::find(newValue));
+    } else if (attrName == u"class") {
+        std::set<Atom> prevClasses;
+        std::set<Atom> newClasses;
+        findClassAtoms(prevValue, prevClasses);
+        findClassAtoms(newValue, newClasses);
+        for (auto i = prevClasses.begin(); i != prevClasses.end(); ++i) {
+            if (newClasses.find(*i) == newClasses.end())
+                position |= getFeature(CSSRuleListImp::ClassFeature, *i);
+        }
+        for (auto i = newClasses.begin(); i != newClasses.end(); ++i) {
+            if (prevClasses.find(*i) == prevClasses.end())
+                position |= getFeature(CSSRuleListImp::ClassFeature, *i);
+        }
+    }
+    return position;
+}
+
 void ViewCSSImp::handleMutation(EventListenerImp* listener, events::Event event)
 {
     if (!boxTree)
@@ -154,9 +298,11 @@ void ViewCSSImp::handleMutation(EventListenerImp* listener, events::Event event)
         if (!Element::hasInstance(parentNode))
             return;
         Node target = interface_cast<Node>(event.getTarget());
-        if (Element::hasInstance(target))
+        if (Element::hasInstance(target)) {
+            // The inserted subtree is matched as it has no computed styles yet.
+            requestSiblingMatching(interface_cast<Element>(target));
             setFlags(Box::NEED_SELECTOR_MATCHING);
-        else if (Element::hasInstance(parentNode)) {
+        } else if (Element::hasInstance(parentNode)) {
             Element element(interface_cast<Element>(parentNode));
             if (CSSStyleDeclarationPtr style = getStyle(element))
                 style->updateInlines(element);
@@ -169,6 +315,7 @@ void ViewCSSImp::handleMutation(EventListenerImp* listener, events::Event event)
         Node target = interface_cast<Node>(event.getTarget());
         if (Element::hasInstance(target)) {
             removeComputedStyle(interface_cast<Element>(target));
+            requestSiblingMatching(interface_cast<Element>(target));
             setFlags(Box::NEED_SELECTOR_MATCHING);
         } else if (Element::hasInstance(parentNode)) {
             Element element(interface_cast<Element>(parentNode));
@@ -179,12 +326,27 @@ void ViewCSSImp::handleMutation(EventListenerImp* listener, events::Event event)
     } else if (mutation.getType() == u"DOMAttrModified") {
         Node target = interface_cast<Node>(event.getTarget());
         if (Element::hasInstance(target)) {
-            if (CSSStyleDeclarationPtr style = getStyle(interface_cast<Element>(target))) {
+            Element element(interface_cast<Element>(target));
+            if (CSSStyleDeclarationPtr style = getStyle(element)) {
+                std::u16string attrName(mutation.getAttrName());
+                unsigned position = 0;
+                if (attrName != u"style") {
+                    position = getAttributeFeature(attrName, mutation.getPrevValue(), mutation.getNewValue());
+                    // The id and class attributes are not used for presentational hints.
+                    if (!position && (attrName == u"id" || attrName == u"class"))
+                        return;
+                }
                 style->requestReconstruct(Box::NEED_STYLE_RECALCULATION);
                 style->clearFlags(CSSStyleDeclarationImp::Computed);
-                if (mutation.getAttrName() != u"style") {
-                    // Request a selector re-matching for the element
-                    style->setFlags(CSSStyleDeclarationImp::NeedSelectorMatching);
+                if (position) {
+                    // Re-match only the element unless the attribute is
+                    // referenced on the left of a combinator.
+                    unsigned flags = CSSStyleDeclarationImp::NeedSelectorMatching;
+                    if (position & CSSRuleListImp::Ancestor)
+                        flags |= CSSStyleDeclarationImp::NeedSubtreeSelectorMatching;
+                    style->setFlags(flags);
+                    if (position & CSSRuleListImp::Sibling)
+                        requestSiblingMatching(element);
                     setFlags(Box::NEED_SELECTOR_MATCHING);
                 }
             }
@@ -203,6 +365,141 @@ void ViewCSSImp::collectRules(CSSRuleListImp::RuleSet& set, Element element, css
     ruleList->collectRules(set, this, element, importance, mediaList);
 }
 
+void ViewCSSImp::collectRules(CSSRuleListImp::RuleSet& set, Element element)
+{
+    if (auto sheet = getDOMImplementation()->getDefaultStyleSheet())
+        collectRules(set, element, sheet->getRules(), CSSRuleListImp::UserAgent);
+    if (auto sheet = getDOMImplementation()->getUserStyleSheet())
+        collectRules(set, element, sheet->getRules(), CSSRuleListImp::User);
+    if (auto sheet = getDOMImplementation()->getPresentationalHints())
+        collectRules(set, element, sheet->getRules(), CSSRuleListImp::Presentational);
+
+    unsigned importance = CSSRuleListImp::Author;
+    stylesheets::StyleSheetList styleSheetList(getDocument()->getStyleSheets());
+    for (unsigned i = 0; i < styleSheetList.getLength(); ++i) {
+        auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>(styleSheetList.getElement(i).self());
+        auto mediaList = std::dynamic_pointer_cast<MediaListImp>(sheet->getMedia().self());
+        collectRules(set, element, sheet->getRules(), importance++, mediaList);
+    }
+}
+
+AncestorFilter* ViewCSSImp::getAncestorFilter() const
+{
+    if (matchingThread && matchingThread->view == this)
+        return matchingThread->filter;
+    return ancestorFilter;
+}
+
+StyleSharingCache* ViewCSSImp::getStyleSharingCache() const
+{
+    // The matching threads do not share the matched rules.
+    if (matchingThread && matchingThread->view == this)
+        return 0;
+    return styleSharingCache;
+}
+
+std::list<Element>& ViewCSSImp::getHoverList()
+{
+    if (matchingThread && matchingThread->view == this)
+        return *matchingThread->hoverList;
+    return hoverList;
+}
+
+// Collects the roots of the subtrees at matchingDepth below element.
+void ViewCSSImp::collectSubtrees(Element element, unsigned depth, std::vector<Element>& roots)
+{
+    if (depth == matchingDepth) {
+        roots.push_back(element);
+        return;
+    }
+    for (Element child = element.getFirstElementChild(); child; child = child.getNextElementSibling())
+        collectSubtrees(child, depth + 1, roots);
+}
+
+// Adds the entries for the subtree in advance so that the matching threads
+// never modify matchedRules itself.
+void ViewCSSImp::reserveMatchedRules(Element element)
+{
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(element.self()))
+        matchedRules[imp.get()];
+    for (Element child = element.getFirstElementChild(); child; child = child.getNextElementSibling())
+        reserveMatchedRules(child);
+}
+
+void ViewCSSImp::matchSubtree(Element element, AncestorFilter& filter, std::list<Element>& hovers)
+{
+    if (auto imp = std::dynamic_pointer_cast<ElementImp>(element.self())) {
+        auto found = matchedRules.find(imp.get());
+        if (found != matchedRules.end()) {
+            collectRules(found->second.ruleSet, element);
+            found->second.hoverList.swap(hovers);
+        }
+        hovers.clear();
+    }
+    filter.push(element);
+    for (Element child = element.getFirstElementChild(); child; child = child.getNextElementSibling())
+        matchSubtree(child, filter, hovers);
+    filter.pop();
+}
+
+// Takes the subtrees from roots one by one until no subtree is left.
+void ViewCSSImp::matchSubtrees(const std::vector<Element>& roots, std::atomic<size_t>& next)
+{
+    AncestorFilter filter;
+    std::list<Element> hovers;
+    MatchingThread state = { this, &filter, &hovers };
+    MatchingThread* saved = matchingThread;
+    matchingThread = &state;
+    for (size_t i = next++; i < roots.size(); i = next++) {
+        std::deque<Element> ancestors;
+        for (Element e = roots[i].getParentElement(); e; e = e.getParentElement())
+            ancestors.push_front(e);
+        for (auto j = ancestors.begin(); j != ancestors.end(); ++j)
+            filter.push(*j);
+        matchSubtree(roots[i], filter, hovers);
+        for (auto j = ancestors.begin(); j != ancestors.end(); ++j)
+            filter.pop();
+    }
+    matchingThread = saved;
+}
+
+// Matches the selectors for the subtrees below matchingDepth on multiple
+// threads. The results are taken by updateStyleRules() in the document
+// order, so the matched rules and the hover lists are the same as the
+// ones matched by a single thread. The elements above matchingDepth and
+// the shadow trees are matched by constructComputedStyle() as before.
+void ViewCSSImp::matchInParallel()
+{
+    unsigned count = matchingThreads ? matchingThreads : std::thread::hardware_concurrency();
+    if (count < 2)
+        return;
+    DocumentPtr document = getDocument();
+    if (!document)
+        return;
+    Element root = document->getDocumentElement();
+    if (!root)
+        return;
+    std::vector<Element> roots;
+    collectSubtrees(root, 0, roots);
+    if (roots.size() < 2)
+        return;
+    for (auto i = roots.begin(); i != roots.end(); ++i)
+        reserveMatchedRules(*i);
+    if (matchedRules.size() < MinParallelMatching) {
+        matchedRules.clear();
+        return;
+    }
+
+    count = std::min<size_t>(count, roots.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < count; ++i)
+        threads.push_back(std::thread(&ViewCSSImp::matchSubtrees, this, std::cref(roots), std::ref(next)));
+    matchSubtrees(roots, next);
+    for (auto i = threads.begin(); i != threads.end(); ++i)
+        i->join();
+}
+
 void ViewCSSImp::resolveXY(float left, float top)
 {
     if (boxTree)
@@ -213,6 +510,7 @@ MediaQueryListPtr ViewCSSImp::matchMedia(const MediaListPtr& mediaList)
 {
     if (!mediaList)
         return nullptr;
+    std::lock_guard<std::mutex> lock(mediaListMutex);
     auto found = mediaListMap.find(mediaList.get());
     if (found != mediaListMap.end())
         return found->second;
@@ -232,9 +530,56 @@ void ViewCSSImp::addStyle(const Element& element, const CSSStyleDeclarationPtr&
     map[element] = style;
 }
 
+ElementImp* StyleSharingCache::getOrigin(ElementImp* element) const
+{
+    auto found = origins.find(element);
+    return (found != origins.end()) ? found->second : element;
+}
+
+CSSStyleDeclarationPtr StyleSharingCache::find(const ElementPtr& element)
+{
+    auto parent = std::dynamic_pointer_cast<ElementImp>(element->getParentElement().self());
+    if (!parent)
+        return nullptr;
+    for (auto i = candidates.begin(); i != candidates.end(); ++i) {
+        ElementImp* candidate = i->element.get();
+        if (candidate == element.get() ||
+            candidate->getLocalNameAtom() != element->getLocalNameAtom() ||
+            candidate->getIdAtom() != element->getIdAtom() ||
+            candidate->getClassAtoms() != element->getClassAtoms() ||
+            !candidate->hasSameAttributes(element.get()))
+            continue;
+        // The ancestors of both elements have to be indistinguishable by selectors.
+        auto candidateParent = std::dynamic_pointer_cast<ElementImp>(candidate->getParentElement().self());
+        if (!candidateParent || getOrigin(candidateParent.get()) != getOrigin(parent.get()))
+            continue;
+        origins[element.get()] = getOrigin(candidate);
+        return i->style;
+    }
+    return nullptr;
+}
+
+void StyleSharingCache::add(const ElementPtr& element, const CSSStyleDeclarationPtr& style)
+{
+    if (!sharable)
+        return;
+    candidates.push_front(Candidate{ element, style });
+    if (MaxCandidates < candidates.size())
+        candidates.pop_back();
+}
+
 void ViewCSSImp::constructComputedStyles()
 {
+    AncestorFilter filter;
+    StyleSharingCache cache;
+    ancestorFilter = &filter;
+    styleSharingCache = &cache;
+    if (map.empty())
+        matchInParallel();
     constructComputedStyle(getDocument(), nullptr);
+    matchedRules.clear();
+    ancestorFilter = 0;
+    styleSharingCache = 0;
     clearFlags(Box::NEED_SELECTOR_MATCHING | Box::NEED_SELECTOR_REMATCHING);  // TODO: Refine
 }
 
@@ -252,10 +597,32 @@ void ViewCSSImp::updateStyleRules(Element element, const CSSStyleDeclarationPtr&
         elementDecl = std::dynamic_pointer_cast<CSSStyleDeclarationImp>(htmlElement.getStyle().self());
     }
 
-    if (auto sheet = getDOMImplementation()->getDefaultStyleSheet())
-        collectRules(style->ruleSet, element, sheet->getCssRules(), CSSRuleListImp::UserAgent);
-    if (auto sheet = getDOMImplementation()->getUserStyleSheet())
-        collectRules(style->ruleSet, element, sheet->getCssRules(), CSSRuleListImp::User);
+    auto imp = std::dynamic_pointer_cast<ElementImp>(element.self());
+    auto matched = imp ? matchedRules.find(imp.get()) : matchedRules.end();
+    CSSStyleDeclarationPtr shared;
+    if (styleSharingCache && imp && matched == matchedRules.end())
+        shared = styleSharingCache->find(imp);
+    if (matched != matchedRules.end()) {
+        // The rules have been matched by matchInParallel().
+        style->ruleSet.swap(matched->second.ruleSet);
+        hoverList.swap(matched->second.hoverList);
+        matchedRules.erase(matched);
+    } else if (shared) {
+        // Reuse the rules matched for an equivalent element except for its own
+        // presentational hints.
+        for (auto i = shared->ruleSet.begin(); i != shared->ruleSet.end(); ++i) {
+            if (i->getSelector())
+                style->ruleSet.insert(*i);
+        }
+    } else {
+        if (styleSharingCache)
+            styleSharingCache->beginMatching();
+        collectRules(style->ruleSet, element);
+
+        // Elements that have matched :hover are not shared so that hoverList is maintained.
+        if (styleSharingCache && imp && hoverList.empty())
+            styleSharingCache->add(imp, style);
+    }
     if (elementDecl) {
         if (CSSStyleDeclarationPtr nonCSS = elementDecl->getPseudoElementStyle(CSSPseudoElementSelector::NonCSS)) {
             // TODO: emplace() seems to be not ready yet with libstdc++.
@@ -263,16 +630,6 @@ void ViewCSSImp::updateStyleRules(Element element, const CSSStyleDeclarationPtr&
             style->ruleSet.insert(rule);
         }
     }
-    if (auto sheet = getDOMImplementation()->getPresentationalHints())
-        collectRules(style->ruleSet, element, sheet->getCssRules(), CSSRuleListImp::Presentational);
-
-    unsigned importance = CSSRuleListImp::Author;
-    stylesheets::StyleSheetList styleSheetList(getDocument()->getStyleSheets());
-    for (unsigned i = 0; i < styleSheetList.getLength(); ++i) {
-        auto sheet = std::dynamic_pointer_cast<CSSStyleSheetImp>(styleSheetList.getElement(i).self());
-        auto mediaList = std::dynamic_pointer_cast<MediaListImp>(sheet->getMedia().self());
-        collectRules(style->ruleSet, element, sheet->getCssRules(), importance++, mediaList);
-    }
 
     style->compute(this, parentStyle, element);
     if (parentStyle && htmlElement && htmlElement.getLocalName() == u"body") {
@@ -322,8 +679,9 @@ bool ViewCSSImp::expandBinding(Element element, const CSSStyleDeclarationPtr& st
     return false;
 }
 
-unsigned ViewCSSImp::constructComputedStyle(Node node, CSSStyleDeclarationPtr parentStyle, unsigned propagetFlags)
+void ViewCSSImp::constructComputedStyle(Node node, CSSStyleDeclarationPtr parentStyle, unsigned propagetFlags)
 {
+    AncestorFilter* filter = ancestorFilter;
     CSSStyleDeclarationPtr style;
     Element element((node.getNodeType() == Node::ELEMENT_NODE) ? interface_cast<Element>(node) : nullptr);
     if (element) {
@@ -335,9 +693,13 @@ unsigned ViewCSSImp::constructComputedStyle(Node node, CSSStyleDeclarationPtr pa
         if (found != map.end()) {
             style = found->second;
             assert(style);
-            if ((style->getFlags() | propagetFlags) & CSSStyleDeclarationImp::NeedSelectorMatching) {
-                propagetFlags = CSSStyleDeclarationImp::NeedSelectorMatching;
-                style->clearFlags(CSSStyleDeclarationImp::NeedSelectorMatching);
+            unsigned flags = style->getFlags() | propagetFlags;
+            if (flags & CSSStyleDeclarationImp::NeedSelectorMatching) {
+                // The descendants are re-matched with the element only if
+                // the change could affect them.
+                propagetFlags = (flags & CSSStyleDeclarationImp::NeedSubtreeSelectorMatching) ?
+                    (CSSStyleDeclarationImp::NeedSelectorMatching | CSSStyleDeclarationImp::NeedSubtreeSelectorMatching) : 0;
+                style->clearFlags(CSSStyleDeclarationImp::NeedSelectorMatching | CSSStyleDeclarationImp::NeedSubtreeSelectorMatching);
                 CSSStyleDeclarationBoard board(style);
                 style->resetComputedStyle();
                 updateStyleRules(element, style, parentStyle);
@@ -349,19 +711,27 @@ unsigned ViewCSSImp::constructComputedStyle(Node node, CSSStyleDeclarationPtr pa
         } else {
             style = window->getComputedStyle(element);
             if (!style)
-                return propagetFlags;  // TODO: error
+                return;  // TODO: error
             addStyle(element, style);
             updateStyleRules(element, style, parentStyle);
+            // Any descendant left from a previous insertion needs to be re-matched, too.
+            propagetFlags = CSSStyleDeclarationImp::NeedSelectorMatching | CSSStyleDeclarationImp::NeedSubtreeSelectorMatching;
         }
         if (auto imp = std::dynamic_pointer_cast<HTMLElementImp>(element.self())) {
-            if (html::HTMLTemplateElement shadow = imp->getShadowTree())
+            if (html::HTMLTemplateElement shadow = imp->getShadowTree()) {
                 node = shadow;
+                // The ancestors of the shadow content are not those of element.
+                ancestorFilter = 0;
+            }
         }
     }
-    unsigned siblingFlags = propagetFlags;
+    if (element && ancestorFilter)
+        ancestorFilter->push(element);
     for (Node child = node.getFirstChild(); child; child = child.getNextSibling())
-        siblingFlags = constructComputedStyle(child, style, siblingFlags);
-    return propagetFlags;
+        constructComputedStyle(child, style, propagetFlags);
+    if (element && ancestorFilter)
+        ancestorFilter->pop();
+    ancestorFilter = filter;
 }
 
 void ViewCSSImp::calculateComputedStyles()
@@ -861,6 +1231,8 @@ BlockPtr ViewCSSImp::constructBlocks()
 
 BlockPtr ViewCSSImp::layOut()
 {
+    invalidateDisplayList();
+    tileable = true;
     quotingDepth = 0;
     scrollWidth = 0.0f;
     scrollHeight = 0.0f;
@@ -891,6 +1263,67 @@ BlockPtr ViewCSSImp::layOut()
     return boxTree;
 }
 
+// Returns true if a box other than the root box needs to be repainted,
+// e.g., a scrollable box has been scrolled. Note the view itself sets
+// NEED_REPAINT on the root box.
+bool ViewCSSImp::hasBoxesToRepaint() const
+{
+    if (!boxTree)
+        return false;
+    for (BoxPtr box = boxTree->getFirstChild(); box; box = box->getNextSibling()) {
+        if (box->gatherFlags() & Box::NEED_REPAINT)
+            return true;
+    }
+    return false;
+}
+
+void ViewCSSImp::addDamage(const CanvasRect& rect)
+{
+    if (damage.right <= damage.left || damage.bottom <= damage.top)
+        damage = rect;
+    else {
+        damage.left = std::min(damage.left, rect.left);
+        damage.top = std::min(damage.top, rect.top);
+        damage.right = std::max(damage.right, rect.right);
+        damage.bottom = std::max(damage.bottom, rect.bottom);
+    }
+    if (boxTree)
+        boxTree->setFlags(Box::NEED_REPAINT);
+    else
+        flags |= Box::NEED_REPAINT;
+}
+
+void ViewCSSImp::invalidateAnimatedImages()
+{
+    if (animatedImages.empty()) {
+        setFlags(Box::NEED_REPAINT);
+        return;
+    }
+    for (auto i = animatedImages.begin(); i != animatedImages.end(); ++i)
+        addDamage(*i);
+}
+
+void ViewCSSImp::invalidateChildWindow(const WindowProxy* child)
+{
+    auto found = childWindows.find(child);
+    if (found == childWindows.end()) {
+        setFlags(Box::NEED_REPAINT);
+        return;
+    }
+    addDamage(found->second);
+}
+
+bool ViewCSSImp::getDamage(int& left, int& top, int& right, int& bottom) const
+{
+    if (damagedAll)
+        return false;
+    left = std::floor(damage.left);
+    top = std::floor(damage.top);
+    right = std::ceil(damage.right);
+    bottom = std::ceil(damage.bottom);
+    return true;
+}
+
 BlockPtr ViewCSSImp::dump()
 {
     std::cout << "## render tree\n";
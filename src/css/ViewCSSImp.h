@@ -24,7 +24,13 @@
 #include <org/w3c/dom/css/CSSStyleDeclaration.h>
 #include <org/w3c/dom/html/HTMLTemplateElement.h>
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "WindowImp.h"
 #include "ElementImp.h"
@@ -38,6 +44,8 @@
 
 #include "html/MediaQueryListImp.h"
 
+class Canvas;
+
 namespace org { namespace w3c { namespace dom {
 
 class Document;
@@ -46,11 +54,51 @@ namespace bootstrap {
 
 class StackingContext;
 
+// StyleSharingCache keeps the elements that have been matched against the
+// style sheets recently so that a sibling or a cousin with the same tag
+// name and attributes can reuse their matched rules.
+class StyleSharingCache
+{
+    static const size_t MaxCandidates = 8;
+
+    struct Candidate
+    {
+        ElementPtr element;
+        CSSStyleDeclarationPtr style;
+    };
+    std::deque<Candidate> candidates;
+    std::unordered_map<ElementImp*, ElementImp*> origins;  // element -> the element whose rules have been reused
+    bool sharable;
+
+    ElementImp* getOrigin(ElementImp* element) const;
+
+public:
+    StyleSharingCache() :
+        sharable(true)
+    {}
+
+    // Called by the selector matching when the result depends on something
+    // other than the element's tag name, attributes and ancestors.
+    void setUnsharable() {
+        sharable = false;
+    }
+    void beginMatching() {
+        sharable = true;
+    }
+    bool isSharable() const {
+        return sharable;
+    }
+
+    CSSStyleDeclarationPtr find(const ElementPtr& element);
+    void add(const ElementPtr& element, const CSSStyleDeclarationPtr& style);
+};
+
 class ViewCSSImp
 {
     friend class CSSPseudoClassSelector;    // TODO: only for match()
 
     static const unsigned MaxFontSizes = 8;
+    static const size_t MinParallelMatching = 256;  // elements
 
     ContainingBlockPtr initialContainingBlock;
 
@@ -63,12 +111,27 @@ class ViewCSSImp
     Retained<EventListenerImp> mutationListener;
 
     std::map<MediaListImp*, MediaQueryListPtr> mediaListMap;
+    std::mutex mediaListMutex;  // for matchMedia() called by the selector matching threads
     bool mediaCheck;
 
     // Selector matching
     std::map<Element, CSSStyleDeclarationPtr> map;
     std::list<Element> hoverList;
     unsigned overflow;
+    AncestorFilter* ancestorFilter;     // valid only while constructing computed styles
+    StyleSharingCache* styleSharingCache;   // valid only while constructing computed styles
+
+    // The rules matched in advance by the selector matching threads; valid
+    // only while constructing computed styles
+    struct MatchedRules
+    {
+        CSSRuleListImp::RuleSet ruleSet;
+        std::list<Element> hoverList;
+    };
+    std::unordered_map<ElementImp*, MatchedRules> matchedRules;
+
+    static unsigned matchingThreads;
+    static unsigned matchingDepth;
 
     // Style recalculation
     StackingContextPtr stackingContexts;
@@ -85,17 +148,87 @@ class ViewCSSImp
     unsigned clipCount;
     unsigned short flags{0};
 
+    // The rendering of the stacking contexts is retained as a sequence of
+    // GL display lists, and replayed until the boxes, the scroll position or
+    // the transformation of the view is changed. An operation that has to
+    // run at every repaint, e.g., rendering a child window or the current
+    // frame of an animated image, is kept as a callback between the lists.
+    struct DisplayItem
+    {
+        unsigned list;  // GL display list name, or 0 for a callback
+        std::function<void()> callback;
+        unsigned clipCount;
+    };
+    std::vector<DisplayItem> displayList;
+    float displayMatrix[16];    // the modelview matrix the display list has been recorded with
+    unsigned displayFontUpdates;
+    bool retainable;
+    bool recording;
+
+    // Damage tracking, in the coordinates of the canvas of the view
+    struct CanvasRect
+    {
+        float left;
+        float top;
+        float right;
+        float bottom;
+    };
+    float originX;  // the position of the view in the modelview coordinates while rendering
+    float originY;
+    CanvasRect damage;      // the region to repaint unless damagedAll is set
+    bool damagedAll;
+    std::vector<CanvasRect> animatedImages;  // rendered in the last repaint
+    std::map<const WindowProxy*, CanvasRect> childWindows;   // rendered in the last repaint
+
+    // Tiled rendering: the document is rasterized into the tiles of
+    // TileSize pixels square placed in the document, so that scrolling only
+    // composes the tiles and rasterizes the newly exposed ones.
+    static const int TileSize = 256;    // [px]
+    static bool tiledRendering;
+    std::map<std::pair<int, int>, std::shared_ptr<Canvas>> tiles;
+    Canvas* tileCanvas;     // the tile being rasterized
+    float tileLeft;         // the region of the tile being rasterized
+    float tileTop;
+    bool retainableTiles;
+    bool tileable;          // false if the rendering depends on the scroll position, etc.
+
     // Animation
     unsigned last;   // in 1/100 sec for GIF
     unsigned delay;  // in 1/100 sec for GIF
 
     void removeComputedStyle(Element element);
 
+    bool isSiblingDependent(css::CSSRuleList list);
+    bool isSiblingDependent();
+    void requestSiblingMatching(Element element);
+    unsigned getFeature(css::CSSRuleList list, int feature, const Atom& name);
+    unsigned getFeature(int feature, const Atom& name);
+    unsigned getAttributeFeature(const std::u16string& name, const std::u16string& prevValue, const std::u16string& newValue);
     void handleMutation(EventListenerImp* listener, events::Event event);
     void collectRules(CSSRuleListImp::RuleSet& set, Element element, css::CSSRuleList list, unsigned importance, MediaListPtr mediaList = nullptr);
+    void collectRules(CSSRuleListImp::RuleSet& set, Element element);
+    void collectSubtrees(Element element, unsigned depth, std::vector<Element>& roots);
+    void reserveMatchedRules(Element element);
+    void matchSubtree(Element element, AncestorFilter& filter, std::list<Element>& hovers);
+    void matchSubtrees(const std::vector<Element>& roots, std::atomic<size_t>& next);
+    void matchInParallel();
+    std::list<Element>& getHoverList();
     void updateStyleRules(Element element, const CSSStyleDeclarationPtr& style, CSSStyleDeclarationPtr parentStyle);
     bool expandBinding(Element element, const CSSStyleDeclarationPtr& style);
 
+    bool hasBoxesToRepaint() const;
+    void beginDisplayItem();
+    void recordDisplayList();
+    void replayDisplayList();
+    void discardDisplayList();
+
+    CanvasRect getCanvasRect(float x, float y, float w, float h) const;
+    void addDamage(const CanvasRect& rect);
+
+    void resolveScrollSize();
+    bool renderTiles();
+    void rasterizeTile(int x, int y, Canvas* tile);
+
 public:
     ViewCSSImp(WindowPtr window);
     virtual ~ViewCSSImp();
@@ -117,7 +250,19 @@ public:
     // Selector matching
     void addStyle(const Element& element, const CSSStyleDeclarationPtr& style);
     void constructComputedStyles();
-    unsigned constructComputedStyle(Node node, CSSStyleDeclarationPtr parentStyle, unsigned propagateFlags = 0);
+    void constructComputedStyle(Node node, CSSStyleDeclarationPtr parentStyle, unsigned propagateFlags = 0);
+    AncestorFilter* getAncestorFilter() const;
+    StyleSharingCache* getStyleSharingCache() const;
+
+    // Sets the number of the threads used for matching the selectors of a
+    // new view; 0 to use every processor, and 1 to disable the threads.
+    static void setMatchingThreads(unsigned count) {
+        matchingThreads = count;
+    }
+    // Sets the depth of the subtrees distributed to the matching threads.
+    static void setMatchingDepth(unsigned depth) {
+        matchingDepth = depth;
+    }
 
     // Style recalculation
     void calculateComputedStyles();
@@ -144,6 +289,41 @@ public:
     void endTranslucent(float alpha);
     void render(unsigned clipCount);
     void renderCanvas(unsigned color);
+    // Runs callback now, and at every replay of the display list being
+    // recorded instead of retaining the GL commands issued by callback.
+    void renderLive(std::function<void()> callback);
+    // Prevents the display list from being replayed, e.g., since a texture
+    // has been uploaded while recording it.
+    void invalidateDisplayList() {
+        retainable = false;
+        retainableTiles = false;
+    }
+    bool isRecording() const {
+        return recording;
+    }
+
+    // Called while rendering something that cannot be kept in the tiles,
+    // e.g., a fixed positioned box.
+    void disableTiles() {
+        tileable = false;
+    }
+    // Enables or disables the tiled rendering; enabled by default.
+    static void setTiledRendering(bool enabled) {
+        tiledRendering = enabled;
+    }
+    // Gets the region of the document being rendered; the viewport, or the
+    // tile being rasterized.
+    void getRenderArea(float& left, float& top, float& width, float& height) const;
+
+    // Records the regions that can change without a relayout while rendering.
+    void addAnimatedImage(float x, float y, float w, float h);
+    void addChildWindow(const WindowProxy* child, float w, float h);
+    // Requests to repaint only the animated images, or a child window.
+    void invalidateAnimatedImages();
+    void invalidateChildWindow(const WindowProxy* child);
+    // Gets the region of the canvas to repaint; returns false if the whole
+    // canvas needs to be repainted.
+    bool getDamage(int& left, int& top, int& right, int& bottom) const;
     unsigned getBackgroundColor();
 
     // Misc.
@@ -296,6 +476,8 @@ public:
         return boxTree;
     }
     void setFlags(unsigned short flags) {
+        if (flags & Box::NEED_REPAINT)
+            damagedAll = true;
         if (boxTree)
             boxTree->setFlags(flags);
         else if (flags & Box::NEED_REPAINT)
@@ -307,6 +489,10 @@ public:
         return flags;
     }
     void clearFlags(unsigned short flags = 0xffff) {
+        if ((flags & Box::NEED_REPAINT) && hasBoxesToRepaint()) {
+            invalidateDisplayList();
+            damagedAll = true;
+        }
         if (boxTree)
             boxTree->clearFlags(flags);
         this->flags &= ~flags;
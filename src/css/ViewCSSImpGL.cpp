@@ -19,6 +19,8 @@
 #include <org/w3c/dom/Text.h>
 #include <org/w3c/dom/Comment.h>
 
+#include <algorithm>
+#include <cmath>
 #include <new>
 
 #include "CSSStyleRuleImp.h"
@@ -27,6 +29,7 @@
 #include "WindowProxy.h"
 
 #include "Box.h"
+#include "Canvas.h"
 #include "StackingContext.h"
 
 #include "font/FontDatabase.h"
@@ -91,37 +94,255 @@ FontTexture* ViewCSSImp::selectAltFont(const CSSStyleDeclarationPtr& style, Font
 
 void ViewCSSImp::beginTranslucent()
 {
+    if (tileCanvas) {
+        tileCanvas->beginTranslucent();
+        return;
+    }
+    // The canvas allocates a new texture for each translucent layer.
     if (auto imp = window->getWindowProxy())
-        imp->beginTranslucent();
+        renderLive([=]() { imp->beginTranslucent(); });
 }
 
 void ViewCSSImp::endTranslucent(float alpha)
 {
+    if (tileCanvas) {
+        tileCanvas->endTranslucent(alpha);
+        return;
+    }
     if (auto imp = window->getWindowProxy())
-        imp->endTranslucent(alpha);
+        renderLive([=]() { imp->endTranslucent(alpha); });
+}
+
+void ViewCSSImp::renderLive(std::function<void()> callback)
+{
+    if (!recording) {
+        callback();
+        return;
+    }
+    glEndList();
+    displayList.push_back(DisplayItem{0, callback, clipCount});
+    recording = false;
+    callback();
+    recording = true;
+    beginDisplayItem();
+}
+
+void ViewCSSImp::beginDisplayItem()
+{
+    GLuint list = glGenLists(1);
+    glNewList(list, GL_COMPILE_AND_EXECUTE);
+    displayList.push_back(DisplayItem{list, nullptr, clipCount});
+}
+
+void ViewCSSImp::recordDisplayList()
+{
+    discardDisplayList();
+
+    // Upload the glyphs rasterized by the layout before recording so that the
+    // display list does not keep the texture updates.
+    backend.flush();
+    unsigned fontUpdates = backend.getUpdateCount();
+
+    retainable = true;
+    recording = true;
+    beginDisplayItem();
+    stackingContexts->render(this);
+    glEndList();
+    recording = false;
+
+    displayFontUpdates = backend.getUpdateCount();
+    if (fontUpdates != displayFontUpdates)
+        retainable = false;
+}
+
+void ViewCSSImp::replayDisplayList()
+{
+    for (auto i = displayList.begin(); i != displayList.end(); ++i) {
+        if (i->list)
+            glCallList(i->list);
+        else {
+            clipCount = i->clipCount;
+            i->callback();
+        }
+    }
+    clipCount = 0;
+}
+
+void ViewCSSImp::discardDisplayList()
+{
+    for (auto i = displayList.begin(); i != displayList.end(); ++i) {
+        if (i->list)
+            glDeleteLists(i->list, 1);
+    }
+    displayList.clear();
+}
+
+ViewCSSImp::CanvasRect ViewCSSImp::getCanvasRect(float x, float y, float w, float h) const
+{
+    // Note no box is rotated or skewed.
+    GLfloat m[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, m);
+    float left = m[0] * x + m[12] - originX;
+    float top = m[5] * y + m[13] - originY;
+    return CanvasRect{ left, top, left + m[0] * w, top + m[5] * h };
+}
+
+void ViewCSSImp::addAnimatedImage(float x, float y, float w, float h)
+{
+    disableTiles();
+    animatedImages.push_back(getCanvasRect(x, y, w, h));
+}
+
+void ViewCSSImp::addChildWindow(const WindowProxy* child, float w, float h)
+{
+    disableTiles();
+    childWindows[child] = getCanvasRect(0.0f, 0.0f, w, h);
+}
+
+void ViewCSSImp::getRenderArea(float& left, float& top, float& width, float& height) const
+{
+    if (tileCanvas) {
+        left = tileLeft;
+        top = tileTop;
+        width = height = TileSize / zoom;
+    } else {
+        left = window->getScrollX();
+        top = window->getScrollY();
+        width = initialContainingBlock->width;
+        height = initialContainingBlock->height;
+    }
+}
+
+void ViewCSSImp::resolveScrollSize()
+{
+    stackingContexts->resetScrollSize();
+    if (boxTree) {
+        boxTree->scrollWidth = getInitialContainingBlock()->getWidth();
+        boxTree->scrollHeight = getInitialContainingBlock()->getHeight();
+    }
+    stackingContexts->resolveScrollSize(this);
+}
+
+void ViewCSSImp::rasterizeTile(int x, int y, Canvas* tile)
+{
+    // Note the tile is placed at the origin of the view while rasterizing.
+    tile->setup(TileSize, TileSize);
+    tile->beginRender(getBackgroundColor());
+    glPushMatrix();
+    glTranslatef(-x * TileSize, -y * TileSize, 0.0f);
+    glScalef(zoom, zoom, zoom);
+    tileCanvas = tile;
+    tileLeft = x * TileSize / zoom;
+    tileTop = y * TileSize / zoom;
+    clipCount = 0;
+    glStencilFunc(GL_EQUAL, 0, 0xFF);
+    stackingContexts->render(this);
+    tileCanvas = 0;
+    glPopMatrix();
+    tile->endRender();
+}
+
+// Renders the document through the tiles; returns false if the document
+// cannot be rendered through the tiles.
+bool ViewCSSImp::renderTiles()
+{
+    if (!tiledRendering || !tileable || !boxTree || !canScroll())
+        return false;
+    float width = initialContainingBlock->width * zoom;
+    float height = initialContainingBlock->height * zoom;
+    if (boxTree->getScrollWidth() * zoom <= width && boxTree->getScrollHeight() * zoom <= height)
+        return false;   // not scrollable
+    // The tiles are rasterized through the current viewport.
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewport[2] < TileSize || viewport[3] < TileSize)
+        return false;
+
+    if (!retainableTiles) {
+        tiles.clear();
+        retainableTiles = true;
+        resolveScrollSize();
+    }
+
+    float scrollX = window->getScrollX() * zoom;
+    float scrollY = window->getScrollY() * zoom;
+    int left = std::floor(scrollX / TileSize);
+    int top = std::floor(scrollY / TileSize);
+    int right = std::ceil((scrollX + width) / TileSize);
+    int bottom = std::ceil((scrollY + height) / TileSize);
+    for (int y = top; y < bottom; ++y) {
+        for (int x = left; x < right; ++x) {
+            std::shared_ptr<Canvas>& tile = tiles[std::make_pair(x, y)];
+            if (tile)
+                continue;
+            tile = std::make_shared<Canvas>();
+            rasterizeTile(x, y, tile.get());
+            if (!tileable) {
+                tiles.clear();
+                return false;
+            }
+        }
+    }
+
+    // The tiles keep premultiplied colors.
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    for (int y = top; y < bottom; ++y) {
+        for (int x = left; x < right; ++x) {
+            glPushMatrix();
+            glTranslatef(x * TileSize - scrollX, y * TileSize - scrollY, 0.0f);
+            tiles[std::make_pair(x, y)]->render(TileSize, TileSize);
+            glPopMatrix();
+        }
+    }
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Keep the tiles within a viewport from the visible ones.
+    int w = right - left;
+    int h = bottom - top;
+    for (auto i = tiles.begin(); i != tiles.end();) {
+        if (i->first.first < left - w || right + w <= i->first.first ||
+            i->first.second < top - h || bottom + h <= i->first.second)
+            i = tiles.erase(i);
+        else
+            ++i;
+    }
+    return true;
 }
 
 void ViewCSSImp::render(unsigned parentClipCount)
 {
     last = getTick();
 
+    GLfloat origin[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, origin);
+    originX = origin[12];
+    originY = origin[13];
+    animatedImages.clear();
+    childWindows.clear();
+
     // reset clipCount
     clipCount = 0;
     glStencilFunc(GL_EQUAL, 0, 0xFF);
 
-    glPushMatrix();
-    glScalef(zoom, zoom, zoom);
-    glTranslatef(-window->getScrollX(), -window->getScrollY(), 0.0f);
-    if (stackingContexts) {
-        stackingContexts->resetScrollSize();
-        if (boxTree) {
-            boxTree->scrollWidth = getInitialContainingBlock()->getWidth();
-            boxTree->scrollHeight = getInitialContainingBlock()->getHeight();
+    if (stackingContexts && !renderTiles()) {
+        glPushMatrix();
+        glScalef(zoom, zoom, zoom);
+        glTranslatef(-window->getScrollX(), -window->getScrollY(), 0.0f);
+        // The display list keeps the absolute matrices loaded by the
+        // stacking contexts; replay it only with the same transformation.
+        GLfloat m[16];
+        glGetFloatv(GL_MODELVIEW_MATRIX, m);
+        if (retainable && !displayList.empty() &&
+            displayFontUpdates == backend.getUpdateCount() &&
+            std::equal(m, m + 16, displayMatrix))
+            replayDisplayList();
+        else {
+            std::copy(m, m + 16, displayMatrix);
+            resolveScrollSize();
+            recordDisplayList();
         }
-        stackingContexts->resolveScrollSize(this);
-        stackingContexts->render(this);
+        glPopMatrix();
     }
-    glPopMatrix();
 
     if (boxTree) {
         float s = boxTree->x + boxTree->stackingContext->getRelativeX();
@@ -138,6 +359,9 @@ void ViewCSSImp::render(unsigned parentClipCount)
 
     // restore clipCount
     glStencilFunc(GL_EQUAL, parentClipCount, 0xFF);
+
+    damage = CanvasRect{ 0.0f, 0.0f, 0.0f, 0.0f };
+    damagedAll = false;
 }
 
 void ViewCSSImp::renderCanvas(unsigned color)
@@ -146,10 +370,10 @@ void ViewCSSImp::renderCanvas(unsigned color)
         return;
 
     glColor4ub(color >> 16, color >> 8, color, color >> 24);
-    float l = window->getScrollX();
-    float r = l + initialContainingBlock->width;
-    float t = window->getScrollY();
-    float b = t + initialContainingBlock->height;
+    float l, t, w, h;
+    getRenderArea(l, t, w, h);
+    float r = l + w;
+    float b = t + h;
     glBegin(GL_QUADS);
     glVertex2f(l, t);
     glVertex2f(r, t);
@@ -70,7 +70,7 @@ public:
     virtual void renderText(FontTexture* font, const char16_t* text, size_t length, float letterSpacing, float wordSpacing) = 0;
 
     virtual void beginRender() = 0;
-    virtual void renderGlyph(FontTexture* fontTexture, FontGlyph* glyph) = 0;
+    virtual void renderGlyph(FontTexture* fontTexture, FontGlyph* glyph, float x, float y, float scale) = 0;
     virtual void endRender() = 0;
 };
 
@@ -278,8 +278,10 @@ public:
     void beginRender() {
         face->getBackEnd()->beginRender();
     }
-    void renderGlyph(FontGlyph* glyph) {
-        face->getBackEnd()->renderGlyph(this, glyph);
+    // Renders glyph with its origin at (x, y); the glyphs rendered between
+    // beginRender() and endRender() can be drawn together.
+    void renderGlyph(FontGlyph* glyph, float x, float y, float scale = 1.0f) {
+        face->getBackEnd()->renderGlyph(this, glyph, x, y, scale);
     }
     void endRender() {
         face->getBackEnd()->endRender();
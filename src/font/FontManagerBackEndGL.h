@@ -22,19 +22,33 @@
 #include <GL/glut.h>
 #include <unicode/uchar.h>
 
+#include <vector>
+
 #include "utf.h"
 
 class FontManagerBackEndGL : public FontManagerBackEnd
 {
+    struct GlyphVertex
+    {
+        GLfloat s, t;
+        GLfloat x, y;
+    };
+
     std::map<uint8_t*, GLuint> texnames;
     FontManager* fontManager;
     FontFace* face;
     FontTexture* fontTexture;
+    unsigned updateCount;
+
+    // The glyph quads to be drawn with the texture of batchImage
+    std::vector<GlyphVertex> batch;
+    uint8_t* batchImage;
 
     void update()
     {
         std::lock_guard<std::mutex> lock(mutex);
         if (!updateList.empty()) {
+            ++updateCount;
             for (auto i = updateList.begin(); i != updateList.end(); ++i) {
                 if (i->second == Add)
                     addImage(i->first);
@@ -64,6 +78,20 @@ class FontManagerBackEndGL : public FontManagerBackEnd
         return it->second;
     }
 
+    void drawGlyphs()
+    {
+        if (batch.empty())
+            return;
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(GlyphVertex), &batch[0].s);
+        glVertexPointer(2, GL_FLOAT, sizeof(GlyphVertex), &batch[0].x);
+        glDrawArrays(GL_QUADS, 0, batch.size());
+        glPopClientAttrib();
+        batch.clear();
+    }
+
     void setMatrixMode()
     {
         glMatrixMode(GL_TEXTURE);
@@ -127,7 +155,9 @@ public:
     FontManagerBackEndGL() :
         fontManager(0),
         face(0),
-        fontTexture(0)
+        fontTexture(0),
+        updateCount(0),
+        batchImage(0)
     {
     }
 
@@ -145,6 +175,18 @@ public:
         return fontManager;
     }
 
+    // Uploads the glyph images rasterized so far to the textures.
+    void flush()
+    {
+        update();
+    }
+
+    // Returns the number of times the textures have been updated so far.
+    unsigned getUpdateCount() const
+    {
+        return updateCount;
+    }
+
     void bindImage(uint8_t* image)
     {
         GLuint texname = getTexname(image);
@@ -172,23 +214,11 @@ public:
         if (!fontTexture)
             return;
         beginRender();
+        float x = 0.0f;
         while ((string = utf8to32(string, &u)) && u) {
             FontGlyph* glyph = fontTexture->getGlyph(u);
-            uint8_t* image = fontTexture->getImage(glyph);
-            bindImage(image);
-            unsigned y = glyph->y % FontTexture::Height;
-            glTranslatef(glyph->left / 64.0f, -(glyph->top - fontTexture->getBearingGap()) / 64.0f, 0.0f);
-            glBegin(GL_QUADS);
-                    glTexCoord2i(glyph->x, y);
-                    glVertex2i(0, 0);
-                    glTexCoord2i(glyph->x + glyph->width, y);
-                    glVertex2i(glyph->width, 0);
-                    glTexCoord2i(glyph->x + glyph->width, y + glyph->height);
-                    glVertex2i(glyph->width, glyph->height);
-                    glTexCoord2i(glyph->x, y + glyph->height);
-                    glVertex2i(0, glyph->height);
-            glEnd();
-            glTranslatef((-glyph->left + glyph->advance) / 64.0f, (glyph->top - fontTexture->getBearingGap()) / 64.0f, 0.0f);
+            renderGlyph(fontTexture, glyph, x, 0.0f, 1.0f);
+            x += glyph->advance / 64.0f;
         }
         endRender();
     }
@@ -197,6 +227,7 @@ public:
                     float letterSpacing, float wordSpacing)
     {
         beginRender();
+        float x = 0.0f;
         const char16_t* end = text + length;
         const char16_t* n;
         for (const char16_t* p = text; p < end; p = n) {
@@ -204,12 +235,12 @@ public:
             n = utf16to32(p, &u);
             if (u != '\n' && u != u'\u200B') {
                 FontGlyph* glyph = fontTexture->getGlyph(u);
-                renderGlyph(fontTexture, glyph);
+                renderGlyph(fontTexture, glyph, x, 0.0f, 1.0f);
                 float spacing = 0.0f;
                 if (u == ' ' || u == u'\u00A0')  // SP or NBSP
                     spacing += wordSpacing;
                 spacing += letterSpacing;
-                glTranslatef((-glyph->left + glyph->advance) / 64.0f + spacing, (glyph->top - fontTexture->getBearingGap()) / 64.0f, 0.0f);
+                x += glyph->advance / 64.0f + spacing;
             }
         }
         endRender();
@@ -221,26 +252,33 @@ public:
         setMatrixMode();
     }
 
-    void renderGlyph(FontTexture* fontTexture, FontGlyph* glyph)
+    // Adds the quad of glyph at the pen position (x, y) to the batch, which
+    // is drawn by endRender() or as soon as the glyph comes from another
+    // texture.
+    void renderGlyph(FontTexture* fontTexture, FontGlyph* glyph, float x, float y, float scale)
     {
         uint8_t* image = fontTexture->getImage(glyph);
-        bindImage(image);
-        unsigned y = glyph->y % FontTexture::Height;
-        glTranslatef(glyph->left / 64.0f, -(glyph->top - fontTexture->getBearingGap()) / 64.0f, 0.0f);
-        glBegin(GL_QUADS);
-                glTexCoord2i(glyph->x, y);
-                glVertex2i(0, 0);
-                glTexCoord2i(glyph->x + glyph->width, y);
-                glVertex2i(glyph->width, 0);
-                glTexCoord2i(glyph->x + glyph->width, y + glyph->height);
-                glVertex2i(glyph->width, glyph->height);
-                glTexCoord2i(glyph->x, y + glyph->height);
-                glVertex2i(0, glyph->height);
-        glEnd();
+        if (image != batchImage) {
+            drawGlyphs();
+            bindImage(image);
+            batchImage = image;
+        }
+        GLfloat s = glyph->x;
+        GLfloat t = glyph->y % FontTexture::Height;
+        GLfloat w = glyph->width;
+        GLfloat h = glyph->height;
+        x += scale * glyph->left / 64.0f;
+        y -= scale * (glyph->top - fontTexture->getBearingGap()) / 64.0f;
+        batch.push_back(GlyphVertex{s, t, x, y});
+        batch.push_back(GlyphVertex{s + w, t, x + scale * w, y});
+        batch.push_back(GlyphVertex{s + w, t + h, x + scale * w, y + scale * h});
+        batch.push_back(GlyphVertex{s, t + h, x, y + scale * h});
     }
 
     void endRender()
     {
+        drawGlyphs();
+        batchImage = 0;
     }
 };
 
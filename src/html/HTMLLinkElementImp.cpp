@@ -16,6 +16,9 @@
 
 #include "HTMLLinkElementImp.h"
 
+#include <map>
+#include <mutex>
+
 #include <boost/bind.hpp>
 #include <boost/version.hpp>
 #include <boost/iostreams/stream.hpp>
@@ -39,6 +42,54 @@ constexpr auto Intern = &one_at_a_time::hash<char16_t>;
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+namespace {
+
+// The parsed style sheets shared by the documents linking the same resource.
+// An entry expires once no style sheet uses its rules.
+class StyleSheetCache
+{
+    std::mutex mutex;
+    std::map<std::u16string, std::weak_ptr<CSSStyleSheetImp::SharedRules>> map;
+
+public:
+    CSSStyleSheetImp::SharedRulesPtr find(const std::u16string& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = map.find(key);
+        if (found == map.end())
+            return nullptr;
+        if (auto rules = found->second.lock())
+            return rules;
+        map.erase(found);
+        return nullptr;
+    }
+    void add(const std::u16string& key, const CSSStyleSheetImp::SharedRulesPtr& rules) {
+        std::lock_guard<std::mutex> lock(mutex);
+        map[key] = rules;
+    }
+};
+
+StyleSheetCache styleSheetCache;
+
+// Returns the key to look up the parsed style sheet of the response, or the
+// empty string if the response has no validator.
+std::u16string getStyleSheetKey(const HttpRequestPtr& request, const DocumentPtr& document)
+{
+    const HttpResponseMessage& response = request->getResponseMessage();
+    if (response.isNoStore())
+        return u"";
+    std::string validator = response.getResponseHeader("ETag");
+    if (validator.empty()) {
+        validator = response.getResponseHeader("Last-Modified");
+        if (validator.empty())
+            return u"";
+    }
+    // The document encoding is used as the fallback encoding of the style sheet.
+    const std::u16string& url = request->getURL();
+    return url + u' ' + utfconv(validator) + u' ' + document->getCharacterSet();
+}
+
+}
+
 HTMLLinkElementImp::HTMLLinkElementImp(DocumentImp* ownerDocument) :
     ObjectMixin(ownerDocument, u"link"),
     dirty(false),
@@ -156,10 +207,28 @@ void HTMLLinkElementImp::linkStyleSheet(const HttpRequestPtr& request)
 
     DocumentPtr document = getOwnerDocumentImp();
     if (current->getStatus() == 200) {
-        boost::iostreams::stream<boost::iostreams::file_descriptor_source> stream(current->getContentDescriptor(), boost::iostreams::close_handle);
-        CSSParser parser(current->getURL());
-        CSSInputStream cssStream(stream, current->getResponseMessage().getContentCharset(), utfconv(document->getCharacterSet()));
-        styleSheet = parser.parse(document, cssStream);
+        std::u16string key = getStyleSheetKey(current, document);
+        CSSStyleSheetImp::SharedRulesPtr rules;
+        if (!key.empty())
+            rules = styleSheetCache.find(key);
+        if (rules) {
+            auto imp = std::make_shared<CSSStyleSheetImp>();
+            imp->setHref(current->getURL());
+            imp->setSharedRules(rules);
+            styleSheet = imp;
+        } else {
+            boost::iostreams::stream<boost::iostreams::file_descriptor_source> stream(current->getContentDescriptor(), boost::iostreams::close_handle);
+            CSSParser parser(current->getURL());
+            CSSInputStream cssStream(stream, current->getResponseMessage().getContentCharset(), utfconv(document->getCharacterSet()));
+            std::u16string cssText = cssStream;
+            styleSheet = parser.parse(document, cssText);
+            if (!key.empty()) {
+                if (auto imp = std::dynamic_pointer_cast<CSSStyleSheetImp>(styleSheet.self())) {
+                    if (rules = imp->share(cssText))
+                        styleSheetCache.add(key, rules);
+                }
+            }
+        }
         if (auto imp = std::dynamic_pointer_cast<CSSStyleSheetImp>(styleSheet.self()))
             imp->setOwnerNode(self());
         styleSheet.setMedia(getMedia());
@@ -1185,9 +1185,7 @@ bool HTMLParser::InBody::processStartTag(HTMLParser* parser, Token& token)
             processEndTag(parser, endTagP);
         parser->insertHtmlElement(token);
         parser->framesetOkFlag = false;
-        Token token = parser->tokenizer->getToken();
-        if (token.getType() != Token::Type::Character || token.getChar() != '\n')
-            parser->processToken(token);
+        parser->skipLineFeed = true;
         return true;
     }
     if (token.getName() == u"form") {
@@ -1350,9 +1348,7 @@ bool HTMLParser::InBody::processStartTag(HTMLParser* parser, Token& token)
     if (token.getName() == u"textarea") {
         parser->insertHtmlElement(token);
         parser->tokenizer->setState(&HTMLTokenizer::rcdataState);
-        Token nextToken = parser->tokenizer->peekToken();
-        if (nextToken.getType() == Token::Type::Character && nextToken.getChar() == '\n')
-            parser->tokenizer->getToken();
+        parser->skipLineFeed = true;
         parser->originalInsertionMode = parser->insertionMode;
         parser->framesetOkFlag = false;
         parser->setInsertionMode(&parser->text);
@@ -2914,12 +2910,18 @@ HTMLParser::HTMLParser(const DocumentPtr& document, HTMLTokenizer* tokenizer, bo
     framesetOkFlag(false),
     insertFromTable(false),
     innerHTML(false),
-    enableXBL(enableXBL)
+    enableXBL(enableXBL),
+    skipLineFeed(false)
 {
 }
 
 bool HTMLParser::processToken(Token& token)
 {
+    if (skipLineFeed) {
+        skipLineFeed = false;
+        if (token.getType() == Token::Type::Character && token.getChar() == '\n')
+            return true;
+    }
     return insertionMode->processToken(this, token);
 }
 
@@ -576,6 +576,11 @@ class HTMLParser
 
     bool enableXBL;   // true if parse elements defined in XBL 2.0.
 
+    // true to ignore the next token if it is a U+000A LINE FEED character,
+    // e.g., after <pre>; the token is not looked ahead so that the parser
+    // does not have to wait for it.
+    bool skipLineFeed;
+
     // fragment case
     // cf. http://www.whatwg.org/specs/web-apps/current-work/multipage/the-end.html#fragment-case
     Element contextElement;
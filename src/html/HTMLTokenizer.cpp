@@ -2377,10 +2377,11 @@ bool Token::append(Attribute& attribute)
 {
     if (attribute.getName().length() == 0)
         return true;
-    if (attrNames.find(attribute.getName()) == attrNames.end()) {
+    Atom name(attribute.getName());
+    if (attrNames.find(name) == attrNames.end()) {
         Attr attr(std::make_shared<org::w3c::dom::bootstrap::AttrImp>(Nullable<std::u16string>(), Nullable<std::u16string>(), attribute.getName(), attribute.getValue()));
         if (attr) {
-            attrNames.insert(attribute.getName());
+            attrNames.insert(name);
             attrList.push_back(attr);
         }
         attribute.clear();
@@ -2392,7 +2393,7 @@ bool Token::append(Attribute& attribute)
 
 Nullable<std::u16string> Token::getAttribute(const std::u16string& name) const
 {
-    if (attrNames.find(name) != attrNames.end()) {
+    if (attrNames.find(Atom::find(name)) != attrNames.end()) {
         for (auto i = attrList.begin(); i != attrList.end(); ++i) {
             Attr attr = *i;
             if (attr.getName() == name)
@@ -4426,18 +4427,39 @@ bool HTMLTokenizer::emit(const Token& tag)
     return true;
 }
 
-Token HTMLTokenizer::peekToken()
+// Fills the token queue. If wait is false, returns false instead of
+// waiting for more input to arrive.
+bool HTMLTokenizer::prepareToken(bool wait)
 {
     for (;;) {
         if (!tokenQueue.empty())
-            return tokenQueue.front();
+            return true;
+        if (speculator) {
+            switch (speculator->fetch(this, wait)) {
+            case SpeculativeTokenizer::Fetched:
+                continue;
+            case SpeculativeTokenizer::WouldBlock:
+                return false;
+            default:
+                break;
+            }
+        }
         int c;
         do {
+            // Note a character reference is consumed at once.
+            if (!wait && speculator && charStack.empty() && !speculator->canRead(SpeculativeTokenizer::MaxLookahead))
+                return false;
             c = getChar();
         } while (!state->consume(this, c));
     }
 }
 
+Token HTMLTokenizer::peekToken()
+{
+    prepareToken(true);
+    return tokenQueue.front();
+}
+
 Token HTMLTokenizer::getToken()
 {
     Token token = peekToken();
@@ -4445,6 +4467,15 @@ Token HTMLTokenizer::getToken()
     return token;
 }
 
+bool HTMLTokenizer::getToken(Token& token)
+{
+    if (!prepareToken(false))
+        return false;
+    token = tokenQueue.front();
+    tokenQueue.pop();
+    return true;
+}
+
 void HTMLTokenizer::insertString(const std::u16string& s)
 {
     for (auto i = s.rbegin(); i < s.rend(); ++i)
@@ -4468,3 +4499,339 @@ void HTMLTokenizer::setContext(org::w3c::dom::Element context)
             setState(&plaintextState);
     }
 }
+
+//
+// SpeculativeTokenizer
+//
+
+bool SpeculativeTokenizer::Input::fill()
+{
+    size_t length = speculator->read(offset, buffer, ChunkSize, decoder);
+    if (length == 0) {
+        eof = true;
+        return false;
+    }
+    next = buffer;
+    limit = buffer + length;
+    return true;
+}
+
+SpeculativeTokenizer::SpeculativeTokenizer(U16InputStream* source) :
+    source(source),
+    base(0),
+    complete(false),
+    stopping(false),
+    generation(0),
+    restartOffset(0),
+    restartState(0),
+    head(0),
+    tail(0),
+    input(this, false),
+    suspended(false),
+    ended(false),
+    scanned(0),
+    workerInput(this, true),
+    tokenizer(&workerInput)
+{
+    thread = std::thread(&SpeculativeTokenizer::run, this);
+}
+
+SpeculativeTokenizer::~SpeculativeTokenizer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        cond.notify_all();
+    }
+    thread.join();
+    while (Batch* batch = pop())
+        delete batch;
+}
+
+// Returns true if the tokenizer in state holds no partial token.
+bool SpeculativeTokenizer::isBoundary(HTMLTokenizer::State* state)
+{
+    return state == &HTMLTokenizer::dataState ||
+           state == &HTMLTokenizer::rcdataState ||
+           state == &HTMLTokenizer::rawtextState ||
+           state == &HTMLTokenizer::scriptDataState ||
+           state == &HTMLTokenizer::plaintextState ||
+           state == &HTMLTokenizer::scriptDataEscapedState ||
+           state == &HTMLTokenizer::scriptDataDoubleEscapedState;
+}
+
+// Returns the state the tree construction is expected to switch the
+// tokenizer to after processing token, or 0 if no switch is expected.
+HTMLTokenizer::State* SpeculativeTokenizer::predictState(const Token& token)
+{
+    if (token.getType() != Token::Type::StartTag || (token.getFlags() & Token::SelfClosing))
+        return 0;
+    const std::u16string& tag = token.getName();
+    if (0 <= findKeyword(tag, {u"title", u"textarea"}))
+        return &HTMLTokenizer::rcdataState;
+    if (0 <= findKeyword(tag, {u"style", u"xmp", u"iframe", u"noembed", u"noframes", u"noscript"}))
+        return &HTMLTokenizer::rawtextState;
+    if (tag == u"script")
+        return &HTMLTokenizer::scriptDataState;
+    if (tag == u"plaintext")
+        return &HTMLTokenizer::plaintextState;
+    return 0;
+}
+
+// Copies up to n characters starting at offset into s. Returns 0 at the end
+// of the source stream.
+size_t SpeculativeTokenizer::read(size_t offset, char16_t* s, size_t n, bool decoder)
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!decoder)
+                cond.wait(lock, [&] { return offset < base + log.length() || complete; });
+            assert(base <= offset);
+            if (offset < base + log.length()) {
+                n = std::min(n, base + log.length() - offset);
+                log.copy(s, n, offset - base);
+                return n;
+            }
+            if (complete)
+                return 0;
+        }
+        decode();
+    }
+}
+
+// Decodes the next chunk of the source stream. Called only from the worker
+// thread. Returns false at the end of the source stream.
+bool SpeculativeTokenizer::decode()
+{
+    char16_t chunk[ChunkSize];
+    size_t length = 0;
+    while (length < ChunkSize && source->get(chunk[length]))
+        ++length;
+    std::lock_guard<std::mutex> lock(mutex);
+    log.append(chunk, length);
+    if (!*source)
+        complete = true;
+    cond.notify_all();
+    return !complete;
+}
+
+// Discards the characters before offset, which will not be read again.
+void SpeculativeTokenizer::trim(size_t offset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (offset - base < TrimSize)
+        return;
+    log.erase(0, offset - base);
+    base = offset;
+}
+
+SpeculativeTokenizer::Batch* SpeculativeTokenizer::tokenize(unsigned generation)
+{
+    Batch* batch = new Batch;
+    batch->generation = generation;
+    batch->begin = workerInput.getOffset();
+    batch->before = tokenizer.state;
+    for (;;) {
+        int c = tokenizer.getChar();
+        if (!tokenizer.state->consume(&tokenizer, c))
+            continue;
+        if (!tokenizer.charStack.empty() || !isBoundary(tokenizer.state))
+            continue;
+        // End the batch after a tag so that the tree construction can
+        // switch the tokenizer state, or run a script that may call
+        // document.write(), before the next batch is taken.
+        Token::Type type = tokenizer.tokenQueue.back().getType();
+        if (type == Token::Type::StartTag || type == Token::Type::EndTag || type == Token::Type::EndOfFile ||
+            MaxBatchSize <= tokenizer.tokenQueue.size())
+            break;
+    }
+    batch->end = workerInput.getOffset();
+    batch->after = tokenizer.state;
+    while (!tokenizer.tokenQueue.empty()) {
+        batch->tokens.push_back(std::move(tokenizer.tokenQueue.front()));
+        tokenizer.tokenQueue.pop();
+    }
+    if (HTMLTokenizer::State* state = predictState(batch->tokens.back()))
+        tokenizer.setState(state);
+    return batch;
+}
+
+// Called from the worker thread. Returns false if batch has been discarded.
+bool SpeculativeTokenizer::push(Batch* batch)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == QueueSize) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] {
+            return stopping || batch->generation != generation || t - head.load(std::memory_order_acquire) < QueueSize;
+        });
+        if (stopping || batch->generation != generation) {
+            delete batch;
+            return false;
+        }
+    }
+    queue[t % QueueSize] = batch;
+    tail.store(t + 1, std::memory_order_release);
+    if (t == head.load(std::memory_order_acquire)) {
+        // The main thread may be waiting in fetch().
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_all();
+    }
+    return true;
+}
+
+// Called from the main thread. Returns 0 if the queue is empty.
+SpeculativeTokenizer::Batch* SpeculativeTokenizer::pop()
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    if (h == t)
+        return 0;
+    Batch* batch = queue[h % QueueSize];
+    head.store(h + 1, std::memory_order_release);
+    if (t - h == QueueSize) {
+        // The worker thread may be waiting in push().
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_all();
+    }
+    return batch;
+}
+
+// Invalidates the queued batches and restarts the worker from offset in
+// state, or suspends the worker if state is 0.
+void SpeculativeTokenizer::restart(size_t offset, HTMLTokenizer::State* state, const std::u16string& tagName)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    restartOffset = offset;
+    restartState = state;
+    restartTagName = tagName;
+    ++generation;
+    cond.notify_all();
+}
+
+void SpeculativeTokenizer::run()
+{
+    unsigned current = 0;
+    bool idle = false;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stopping)
+                return;
+            if (current != generation) {
+                current = generation;
+                idle = !restartState;
+                if (!idle) {
+                    tokenizer.state = restartState;
+                    tokenizer.appropriateTagName = restartTagName;
+                    tokenizer.charStack = std::stack<char16_t>();
+                    tokenizer.tokenQueue = std::queue<Token>();
+                    workerInput.seek(restartOffset);
+                }
+            }
+            if (idle && complete) {
+                cond.wait(lock, [&] { return stopping || current != generation; });
+                continue;
+            }
+        }
+        if (idle) {
+            // Keep decoding the source stream for the main thread.
+            decode();
+            continue;
+        }
+        Batch* batch = tokenize(current);
+        idle = batch->tokens.back().getType() == Token::Type::EndOfFile;
+        push(batch);
+    }
+}
+
+SpeculativeTokenizer::FetchResult SpeculativeTokenizer::fetch(HTMLTokenizer* main, bool wait)
+{
+    if (ended || !main->charStack.empty())
+        return NotFetched;
+    if (suspended) {
+        if (!isBoundary(main->state))
+            return NotFetched;
+        suspended = false;
+        restart(input.getOffset(), main->state, main->appropriateTagName);
+    }
+    for (;;) {
+        Batch* batch = pop();
+        if (!batch) {
+            // Wait only when the tokens are required at once, e.g., for
+            // HTMLParser::mainLoop().
+            if (!wait)
+                return WouldBlock;
+            size_t h = head.load(std::memory_order_relaxed);
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] { return h != tail.load(std::memory_order_acquire); });
+            continue;
+        }
+        if (batch->generation != generation) {
+            delete batch;
+            continue;
+        }
+        if (batch->begin != input.getOffset() || batch->before != main->state) {
+            // Roll back to the position of main.
+            delete batch;
+            suspended = true;
+            restart(0, 0, u"");
+            return NotFetched;
+        }
+        for (auto i = batch->tokens.begin(); i != batch->tokens.end(); ++i) {
+            if (i->getType() == Token::Type::StartTag)
+                main->appropriateTagName = i->getName();
+            else if (i->getType() == Token::Type::EndOfFile)
+                ended = true;
+            main->tokenQueue.push(std::move(*i));
+        }
+        main->state = batch->after;
+        input.seek(batch->end);
+        trim(batch->end);
+        delete batch;
+        return Fetched;
+    }
+}
+
+bool SpeculativeTokenizer::canRead(size_t count)
+{
+    if (count <= input.getBufferedLength())
+        return true;
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete || input.getOffset() + count <= base + log.length();
+}
+
+bool SpeculativeTokenizer::isReady(const HTMLTokenizer* main)
+{
+    if (!main->tokenQueue.empty())
+        return true;
+    if (!suspended && !ended && main->charStack.empty()) {
+        // Discard the invalidated batches so that fetch() does not wait.
+        for (;;) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+                return false;
+            if (queue[h % QueueSize]->generation == generation)
+                return true;
+            delete pop();
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete || input.getOffset() + ReadAhead <= base + log.length();
+}
+
+void SpeculativeTokenizer::scan(boost::function<void (const Token&)> f)
+{
+    size_t t = tail.load(std::memory_order_acquire);
+    scanned = std::max(scanned, head.load(std::memory_order_relaxed));
+    for (; scanned != t; ++scanned) {
+        Batch* batch = queue[scanned % QueueSize];
+        if (batch->generation != generation)
+            continue;
+        for (auto i = batch->tokens.begin(); i != batch->tokens.end(); ++i) {
+            if (i->getType() == Token::Type::StartTag)
+                f(*i);
+        }
+    }
+}
@@ -24,13 +24,20 @@
 #include <org/w3c/dom/Attr.h>
 #include <org/w3c/dom/Element.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <iostream>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <stack>
 #include <string>
+#include <thread>
 
+#include <boost/function.hpp>
+
+#include "Atom.h"
 #include "U16InputStream.h"
 
 class Attribute
@@ -101,7 +108,7 @@ private:
     std::u16string name;
 
     // StartTag/EndTag field
-    std::set<std::u16string> attrNames;
+    std::set<Atom> attrNames;
     std::deque<Attr> attrList;
 
     // Doctype fields
@@ -214,6 +221,8 @@ public:
     }
 };
 
+class SpeculativeTokenizer;
+
 class HTMLTokenizer
 {
     class State
@@ -701,6 +710,8 @@ class HTMLTokenizer
 
     std::queue<Token> tokenQueue;
 
+    SpeculativeTokenizer* speculator;
+
     char32_t replaceCharacter(char32_t number);
     int consumeCharacterReference(int additionalAllowedCharacter = EOF);
 
@@ -753,6 +764,8 @@ class HTMLTokenizer
     bool emit(const std::u16string& s);
     bool emit(const Token& tag);
 
+    bool prepareToken(bool wait);
+
     bool isAppropriate(const std::u16string& name) {
         return name == appropriateTagName;
     }
@@ -761,18 +774,200 @@ public:
     HTMLTokenizer(U16InputStream* stream) :
         stream(stream),
         fromAttribute(false),
-        state(&dataState)
+        state(&dataState),
+        speculator(0)
     {
     }
 
     Token peekToken();
     Token getToken();
+    // Returns false instead of waiting for the input if the tokens are
+    // taken from a SpeculativeTokenizer.
+    bool getToken(Token& token);
 
     void insertString(const std::u16string& s);
 
     void setContext(org::w3c::dom::Element context);
 
+    // Takes the tokens from speculator instead of tokenizing the input
+    // stream whenever they are still valid. The input stream of this
+    // tokenizer must be speculator->getInput().
+    void setSpeculativeTokenizer(SpeculativeTokenizer* speculator) {
+        this->speculator = speculator;
+    }
+
     friend class HTMLParser;
+    friend class SpeculativeTokenizer;
+};
+
+// SpeculativeTokenizer decodes and tokenizes the input stream on a worker
+// thread ahead of the tree construction, which stays on the thread running
+// HTMLParser. The tokens are passed to the HTMLTokenizer used by HTMLParser
+// through a bounded single-producer single-consumer queue in batches. Each
+// batch records the range of the characters it has been tokenized from and
+// the tokenizer states before and after it.
+//
+// Since the tree construction switches the tokenizer state after some start
+// tags, the worker predicts those switches. If a batch does not start at the
+// position and in the state of the HTMLTokenizer, e.g., because the
+// prediction was wrong or document.write() has left the tokenizer in the
+// middle of a token, the queued batches are discarded, the HTMLTokenizer
+// tokenizes the input by itself, and the worker is restarted from the
+// position of the HTMLTokenizer once it reaches the next token boundary.
+class SpeculativeTokenizer
+{
+public:
+    static const size_t ChunkSize = 512;    // in characters
+    static const size_t QueueSize = 256;    // in batches
+    static const size_t MaxBatchSize = 256; // in tokens
+    static const size_t ReadAhead = 4096;   // in characters
+    static const size_t TrimSize = 65536;   // in characters
+    static const size_t MaxLookahead = 64;  // in characters, e.g., for a character reference
+
+    enum FetchResult {
+        Fetched,        // the tokens of the next batch have been taken
+        NotFetched,     // the HTMLTokenizer has to tokenize the input by itself
+        WouldBlock      // the next batch is not ready yet
+    };
+
+private:
+    struct Batch
+    {
+        unsigned generation;
+        size_t begin;
+        size_t end;
+        HTMLTokenizer::State* before;
+        HTMLTokenizer::State* after;
+        std::deque<Token> tokens;
+    };
+
+    // Input reads the characters decoded from the source stream. The
+    // decoder instance used by the worker thread decodes more characters
+    // from the source stream as needed; the other one waits for them.
+    class Input : public U16InputStream
+    {
+        SpeculativeTokenizer* speculator;
+        bool decoder;
+        bool eof;
+        size_t offset;
+        char16_t* next;
+        char16_t* limit;
+        char16_t buffer[ChunkSize];
+
+        bool fill();
+
+    public:
+        Input(SpeculativeTokenizer* speculator, bool decoder) :
+            speculator(speculator),
+            decoder(decoder),
+            eof(false),
+            offset(0),
+            next(buffer),
+            limit(buffer)
+        {}
+        virtual explicit operator bool( ) const {
+            return !eof;
+        }
+        virtual bool operator! () const {
+            return eof;
+        }
+        virtual int peek() {
+            if (next == limit && !fill())
+                return -1;
+            return *next;
+        }
+        virtual Input& get(char16_t& c) {
+            if (next == limit && !fill())
+                return *this;
+            c = *next++;
+            ++offset;
+            return *this;
+        }
+        size_t getOffset() const {
+            return offset;
+        }
+        // Returns the number of the characters that can be read without
+        // calling fill().
+        size_t getBufferedLength() const {
+            return limit - next;
+        }
+        void seek(size_t position) {
+            offset = position;
+            next = limit = buffer;
+            eof = false;
+        }
+    };
+
+    U16InputStream* source;
+
+    // The characters decoded so far; log[0] is the character at base.
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::u16string log;
+    size_t base;
+    bool complete;
+    bool stopping;
+
+    // The generation is incremented each time the queued batches are
+    // invalidated by the main thread.
+    std::atomic_uint generation;
+    size_t restartOffset;
+    HTMLTokenizer::State* restartState;     // 0 to suspend the worker
+    std::u16string restartTagName;
+
+    Batch* queue[QueueSize];
+    std::atomic_size_t head;    // written by the main thread
+    std::atomic_size_t tail;    // written by the worker thread
+
+    // for the main thread
+    Input input;
+    bool suspended;
+    bool ended;
+    size_t scanned;
+
+    // for the worker thread
+    Input workerInput;
+    HTMLTokenizer tokenizer;
+    std::thread thread;
+
+    static bool isBoundary(HTMLTokenizer::State* state);
+    static HTMLTokenizer::State* predictState(const Token& token);
+
+    size_t read(size_t offset, char16_t* s, size_t n, bool decoder);
+    bool decode();
+    void trim(size_t offset);
+
+    Batch* tokenize(unsigned generation);
+    bool push(Batch* batch);
+    Batch* pop();
+    void restart(size_t offset, HTMLTokenizer::State* state, const std::u16string& tagName);
+    void run();
+
+public:
+    SpeculativeTokenizer(U16InputStream* source);
+    ~SpeculativeTokenizer();
+
+    U16InputStream* getInput() {
+        return &input;
+    }
+
+    // Called from HTMLTokenizer on the main thread to move the tokens of the
+    // next batch to the token queue of main. If wait is true, waits for the
+    // next batch instead of returning WouldBlock.
+    FetchResult fetch(HTMLTokenizer* main, bool wait);
+
+    // Returns true if count characters following the position of the
+    // HTMLTokenizer can be read without waiting for more input, or the end
+    // of the input has been reached.
+    bool canRead(size_t count);
+
+    // Returns true if the next token of main can be obtained without waiting
+    // for more input.
+    bool isReady(const HTMLTokenizer* main);
+
+    // Calls f for each start tag in the batches queued since the last call,
+    // e.g., to find the resources to preload while the parser is blocked.
+    void scan(boost::function<void (const Token&)> f);
 };
 
 #endif  // ES_HTMLTOKENIZER_H
@@ -17,9 +17,18 @@
 #include "HTTPCache.h"
 
 #include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
+#include <set>
 
 #include "url/URI.h"
 #include "http/HTTPConnection.h"
@@ -31,10 +40,54 @@
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
+namespace {
+
+// The persistent cache index is a flat file that can be mapped into memory
+// as it is:
+//
+//   IndexHeader
+//   IndexRecord url headers fileName [padding to 8 bytes]
+//   ...
+//
+// The index is always written into a temporary file first and then renamed,
+// so that a crash never leaves a partially written index behind.
+
+const char IndexName[] = "index";
+const char IndexMagic[8] = { 'E', 'S', 'C', 'A', 'C', 'H', 'E', '1' };
+
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t size;  // the size of the whole index file in bytes
+};
+
+struct IndexRecord
+{
+    int64_t requestTime;
+    uint64_t contentLength;
+    uint32_t urlLength;
+    uint32_t headersLength;
+    uint32_t fileNameLength;
+    uint32_t reserved;
+};
+
+size_t align8(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+const char* const TempPrefix = "esrille-";
+
+}  // namespace
+
 void HttpCache::notify(HttpRequest* request, bool error)
 {
     current = 0;
 
+    unsigned long long length = contentLength;
+
     if (error)
         invalidate();
     else {
@@ -46,9 +99,14 @@ void HttpCache::notify(HttpRequest* request, bool error)
             request->constructResponseFromCache(false);
         } else {
             if (!filePath.empty() && filePath != request->getFilePath())
-                remove(filePath.c_str());
+                HttpCacheManager::getInstance().removeFile(filePath);
             response.updateStatus(request->getResponseMessage());
             filePath = request->getFilePath();
+            struct stat status;
+            if (!filePath.empty() && stat(filePath.c_str(), &status) == 0)
+                length = status.st_size;
+            else
+                length = 0;
         }
     }
 
@@ -60,10 +118,12 @@ void HttpCache::notify(HttpRequest* request, bool error)
         pending->constructResponseFromCache(false);
     }
 
-    if (!error)
+    HttpCacheManager& manager(HttpCacheManager::getInstance());
+    if (!error) {
+        manager.resize(this, length);
         return;
+    }
     assert(requests.empty());
-    HttpCacheManager& manager(HttpCacheManager::getInstance());
     manager.remove(this);
     delete this;
 }
@@ -71,12 +131,18 @@ void HttpCache::notify(HttpRequest* request, bool error)
 void HttpCache::invalidate()
 {
     response.clear();
-    contentLength = 0;
+    if (contentLength)
+        HttpCacheManager::getInstance().resize(this, 0);
+    removeFile();
+    requestTime = 0;
+}
+
+void HttpCache::removeFile()
+{
     if (!filePath.empty()) {
-        remove(filePath.c_str());
+        HttpCacheManager::getInstance().removeFile(filePath);
         filePath.clear();
     }
-    requestTime = 0;
 }
 
 HttpCache* HttpCache::send(const HttpRequestPtr& request)
@@ -122,22 +188,64 @@ bool HttpCache::abort(const HttpRequestPtr& request)
     return false;
 }
 
+HttpCacheManager::HttpCacheManager() :
+    maxEntries(DefaultMaxEntries),
+    maxBytes(DefaultMaxBytes),
+    totalBytes(0),
+    hitCount(0),
+    missCount(0),
+    evictionCount(0),
+    modified(false),
+    savedTime(0),
+    saveInterval(DefaultSaveInterval)
+{
+}
+
+std::u16string HttpCacheManager::getKey(const URL& url)
+{
+    std::u16string key(url);
+    if (url.hasFragment())
+        key.erase(key.length() - url.getHash().length());
+    return key;
+}
+
+void HttpCacheManager::setCapacity(size_t entries, unsigned long long bytes)
+{
+    maxEntries = entries;
+    maxBytes = bytes;
+    evict(0);
+}
+
 HttpCache* HttpCacheManager::getCache(const URL& url)
 {
-    for (auto i = lru.begin(); i != lru.end(); ++i) {
-        HttpCache* cache = *i;
-        if (cache->url == url) {
-            lru.erase(i);
-            lru.push_front(cache);
-            return cache;
-        }
+    std::u16string key(getKey(url));
+    auto found = index.find(key);
+    if (found != index.end()) {
+        HttpCache* cache = found->second;
+        lru.splice(lru.begin(), lru, cache->position);
+        return cache;
     }
     HttpCache* cache = new(std::nothrow) HttpCache(url);
-    if (cache)
+    if (cache) {
         lru.push_front(cache);
+        cache->position = lru.begin();
+        index.insert(std::make_pair(key, cache));
+        evict(cache);
+    }
     return cache;
 }
 
+bool HttpCacheManager::isAvailable(const URL& url)
+{
+    auto found = index.find(getKey(url));
+    if (found == index.end())
+        return false;
+    HttpCache* cache = found->second;
+    if (cache->isBusy())
+        return true;
+    return cache->response.isCacheable() && cache->response.isFresh(cache->requestTime) && !cache->filePath.empty();
+}
+
 HttpCache* HttpCacheManager::send(const HttpRequestPtr& request)
 {
     for (;;) {
@@ -152,9 +260,13 @@ HttpCache* HttpCacheManager::send(const HttpRequestPtr& request)
             if (cache->response.isCacheable() && cache->response.isFresh(cache->requestTime)) {
                 if (request->redirect(cache->response))
                     continue;
-                if (code == HttpRequestMessage::HEAD || !cache->filePath.empty())
+                if (code == HttpRequestMessage::HEAD || !cache->filePath.empty()) {
+                    ++hitCount;
+                    ++cache->hitCount;
                     return cache;
+                }
             }
+            ++missCount;
             return cache->send(request);
         }
         break;
@@ -168,25 +280,271 @@ HttpCache* HttpCacheManager::send(const HttpRequestPtr& request)
     return 0;
 }
 
+void HttpCacheManager::resize(HttpCache* cache, unsigned long long length)
+{
+    totalBytes -= cache->contentLength;
+    cache->contentLength = length;
+    totalBytes += length;
+    modified = true;
+    evict(cache);
+}
+
+// Removes the least recently used entries until the cache fits within
+// maxEntries and maxBytes. Entries that are still in use and keep are
+// never evicted.
+void HttpCacheManager::evict(HttpCache* keep)
+{
+    auto i = lru.end();
+    while (i != lru.begin() && (maxEntries < index.size() || maxBytes < totalBytes)) {
+        --i;
+        HttpCache* cache = *i;
+        if (cache == keep || !cache->isEvictable())
+            continue;
+        i = lru.erase(i);
+        index.erase(getKey(cache->url));
+        totalBytes -= cache->contentLength;
+        ++evictionCount;
+        modified = true;
+        cache->removeFile();
+        delete cache;
+    }
+}
+
 void HttpCacheManager::remove(HttpCache* cache)
 {
-    lru.remove(cache);
+    lru.erase(cache->position);
+    index.erase(getKey(cache->url));
+    totalBytes -= cache->contentLength;
+    cache->contentLength = 0;
+    modified = true;
+}
+
+void HttpCacheManager::retainFile(const std::string& path)
+{
+    if (!path.empty())
+        ++references[path].count;
+}
+
+void HttpCacheManager::releaseFile(const std::string& path)
+{
+    auto found = references.find(path);
+    if (found == references.end())
+        return;
+    if (--found->second.count == 0) {
+        if (found->second.removed)
+            ::remove(path.c_str());
+        references.erase(found);
+    }
+}
+
+void HttpCacheManager::removeFile(const std::string& path)
+{
+    if (path.empty())
+        return;
+    auto found = references.find(path);
+    if (found != references.end())
+        found->second.removed = true;  // unlinked by releaseFile()
+    else
+        ::remove(path.c_str());
 }
 
 void HttpCacheManager::dump() {
     for (auto i = lru.begin(); i != lru.end(); ++i) {
         HttpCache* cache = *i;
-        std::cout << static_cast<std::u16string>(cache->url) << ' ' << cache->response.getStatus() << ' ' << cache->filePath << '\n';
+        std::cout << static_cast<std::u16string>(cache->url) << ' ' << cache->response.getStatus() << ' ' << cache->contentLength << ' ' << cache->hitCount << ' ' << cache->filePath << '\n';
     }
+    std::cout << "entries: " << index.size() << '/' << maxEntries <<
+                 ", bytes: " << totalBytes << '/' << maxBytes <<
+                 ", hits: " << hitCount <<
+                 ", misses: " << missCount <<
+                 ", evictions: " << evictionCount << '\n';
 }
 
-HttpCacheManager::~HttpCacheManager()
+bool HttpCacheManager::open(const std::string& path)
+{
+    close();
+    cachePath = path;
+    bool result = load(cachePath + '/' + IndexName);
+    removeOrphans();
+    return result;
+}
+
+bool HttpCacheManager::load(const std::string& indexPath)
+{
+    int fd = ::open(indexPath.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat status;
+    if (fstat(fd, &status) == -1 || status.st_size < static_cast<off_t>(sizeof(IndexHeader))) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = status.st_size;
+    void* map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const char* const start = static_cast<const char*>(map);
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(start);
+    bool result = memcmp(header->magic, IndexMagic, sizeof IndexMagic) == 0 && header->size == size;
+    size_t offset = sizeof(IndexHeader);
+    for (uint32_t n = 0; result && n < header->count; ++n) {
+        if (size - offset < sizeof(IndexRecord)) {
+            result = false;
+            break;
+        }
+        const IndexRecord* record = reinterpret_cast<const IndexRecord*>(start + offset);
+        unsigned long long length = static_cast<unsigned long long>(record->urlLength) + record->headersLength + record->fileNameLength;
+        if (size - offset - sizeof(IndexRecord) < length) {
+            result = false;
+            break;
+        }
+        const char* url = start + offset + sizeof(IndexRecord);
+        const char* headers = url + record->urlLength;
+        const char* fileName = headers + record->headersLength;
+        offset = std::min(size, align8(offset + sizeof(IndexRecord) + length));
+
+        if (maxEntries <= index.size())
+            continue;
+        if (!record->fileNameLength || memchr(fileName, '/', record->fileNameLength))
+            continue;
+        std::string filePath(cachePath + '/' + std::string(fileName, record->fileNameLength));
+        struct stat fileStatus;
+        if (stat(filePath.c_str(), &fileStatus) == -1 || static_cast<uint64_t>(fileStatus.st_size) != record->contentLength)
+            continue;
+        URL key(utfconv(std::string(url, record->urlLength)));
+        if (key.isEmpty() || index.find(getKey(key)) != index.end())
+            continue;
+        HttpCache* cache = new(std::nothrow) HttpCache(key);
+        if (!cache)
+            break;
+        if (!cache->response.parse(headers, headers + record->headersLength)) {
+            delete cache;
+            continue;
+        }
+        cache->requestTime = record->requestTime;
+        cache->contentLength = record->contentLength;
+        cache->filePath = filePath;
+        lru.push_back(cache);
+        cache->position = --lru.end();
+        index.insert(std::make_pair(getKey(key), cache));
+        totalBytes += cache->contentLength;
+    }
+    munmap(map, size);
+    evict(0);
+    return result;
+}
+
+// Removes the body files that are not referenced from the index, e.g., the
+// ones left behind by a crash.
+void HttpCacheManager::removeOrphans()
+{
+    std::set<std::string> files;
+    for (auto i = lru.begin(); i != lru.end(); ++i)
+        files.insert((*i)->filePath);
+    DIR* dir = opendir(cachePath.c_str());
+    if (!dir)
+        return;
+    while (struct dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, TempPrefix, strlen(TempPrefix)) != 0)
+            continue;
+        std::string filePath(cachePath + '/' + entry->d_name);
+        if (files.find(filePath) == files.end())
+            ::remove(filePath.c_str());
+    }
+    closedir(dir);
+}
+
+bool HttpCacheManager::save()
+{
+    if (cachePath.empty())
+        return false;
+
+    std::string buffer(sizeof(IndexHeader), '\0');
+    uint32_t count = 0;
+    for (auto i = lru.begin(); i != lru.end(); ++i) {
+        HttpCache* cache = *i;
+        if (!cache->isEvictable() || cache->filePath.empty() || cache->response.isNoStore() || !cache->response.isCacheable())
+            continue;
+        if (cache->filePath.compare(0, cachePath.length() + 1, cachePath + '/') != 0)
+            continue;
+        std::string url(utfconv(getKey(cache->url)));
+        std::string headers(cache->response.toString() + "\r\n");
+        std::string fileName(cache->filePath.substr(cachePath.length() + 1));
+        IndexRecord record;
+        memset(&record, 0, sizeof record);
+        record.requestTime = cache->requestTime;
+        record.contentLength = cache->contentLength;
+        record.urlLength = url.length();
+        record.headersLength = headers.length();
+        record.fileNameLength = fileName.length();
+        buffer.append(reinterpret_cast<const char*>(&record), sizeof record);
+        buffer += url;
+        buffer += headers;
+        buffer += fileName;
+        buffer.resize(align8(buffer.length()), '\0');
+        ++count;
+    }
+    IndexHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, IndexMagic, sizeof IndexMagic);
+    header.count = count;
+    header.size = buffer.length();
+    buffer.replace(0, sizeof header, reinterpret_cast<const char*>(&header), sizeof header);
+
+    std::string indexPath(cachePath + '/' + IndexName);
+    std::string tempPath(indexPath + ".tmp");
+    int fd = ::open(tempPath.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0600);
+    if (fd == -1)
+        return false;
+    const char* p = buffer.data();
+    size_t length = buffer.length();
+    while (0 < length) {
+        ssize_t written = write(fd, p, length);
+        if (written <= 0) {
+            ::close(fd);
+            ::remove(tempPath.c_str());
+            return false;
+        }
+        p += written;
+        length -= written;
+    }
+    if (fsync(fd) == -1 || ::close(fd) == -1 || rename(tempPath.c_str(), indexPath.c_str()) == -1) {
+        ::remove(tempPath.c_str());
+        return false;
+    }
+    modified = false;
+    savedTime = time(0);
+    return true;
+}
+
+// Saves the index if it has been modified, but not within saveInterval
+// seconds since the last save. Called periodically from the main loop.
+bool HttpCacheManager::flush()
+{
+    if (!modified || cachePath.empty() || time(0) < savedTime + saveInterval)
+        return false;
+    return save();
+}
+
+void HttpCacheManager::close()
 {
+    bool persistent = save();
     while (!lru.empty()) {
         HttpCache* cache = lru.front();
         remove(cache);
+        if (!persistent || !cache->isEvictable())
+            cache->removeFile();
         delete cache;
     }
+    cachePath.clear();
+    modified = false;
+}
+
+HttpCacheManager::~HttpCacheManager()
+{
+    close();
 }
 
 }}}}  // org::w3c::dom::bootstrap
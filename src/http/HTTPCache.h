@@ -19,6 +19,8 @@
 
 #include <fstream>
 #include <list>
+#include <string>
+#include <unordered_map>
 
 #include "http/HTTPRequest.h"
 
@@ -44,6 +46,8 @@ class HttpCache
     std::list<HttpRequestPtr> requests;
     HttpRequestPtr current;
 
+    std::list<HttpCache*>::iterator position;  // in HttpCacheManager::lru
+
     HttpCache* send(const HttpRequestPtr& request);
 
 public:
@@ -51,10 +55,14 @@ public:
     bool isBusy() const {
         return static_cast<bool>(current);
     }
+    bool isEvictable() const {
+        return !current && requests.empty();
+    }
 
     const std::string& getFilePath() const {
         return filePath;
     }
+    void removeFile();
 
     void notify(HttpRequest* request, bool error);
 
@@ -77,23 +85,104 @@ public:
     {
     }
 
-    ~HttpCache()
-    {
-        if (!filePath.empty())
-            remove(filePath.c_str());
-    }
 };
 
 class HttpCacheManager
 {
-    std::list<HttpCache*> lru;
+    static const size_t DefaultMaxEntries = 4096;
+    static const unsigned long long DefaultMaxBytes = 64ull * 1024 * 1024;
+    static const unsigned DefaultSaveInterval = 10;  // in seconds
+
+    std::list<HttpCache*> lru;  // the most recently used entry comes first
+    std::unordered_map<std::u16string, HttpCache*> index;
+
+    size_t maxEntries;
+    unsigned long long maxBytes;
+    unsigned long long totalBytes;
+
+    unsigned long long hitCount;
+    unsigned long long missCount;
+    unsigned long long evictionCount;
+
+    // The cache directory in the profile; empty if the cache is not persistent.
+    std::string cachePath;
+    bool modified;  // true if the index has been modified since the last save
+    long long savedTime;
+    unsigned saveInterval;
+
+    // The body files referred to by the requests constructed from the cache.
+    // A file removed from the cache in the meantime is unlinked when the
+    // last request releases it.
+    struct FileReference
+    {
+        unsigned count;
+        bool removed;
+    };
+    std::unordered_map<std::string, FileReference> references;
+
+    void evict(HttpCache* keep);
+    bool load(const std::string& indexPath);
+    void removeOrphans();
+
 public:
+    HttpCacheManager();
     ~HttpCacheManager();
 
+    // Returns the cache key for url, i.e., url without its fragment.
+    static std::u16string getKey(const URL& url);
+
+    void setCapacity(size_t entries, unsigned long long bytes);
+    size_t getMaxEntries() const {
+        return maxEntries;
+    }
+    unsigned long long getMaxBytes() const {
+        return maxBytes;
+    }
+    size_t getEntryCount() const {
+        return index.size();
+    }
+    unsigned long long getTotalBytes() const {
+        return totalBytes;
+    }
+    unsigned long long getHitCount() const {
+        return hitCount;
+    }
+    unsigned long long getMissCount() const {
+        return missCount;
+    }
+    unsigned long long getEvictionCount() const {
+        return evictionCount;
+    }
+
     HttpCache* getCache(const URL& url);
     HttpCache* send(const HttpRequestPtr& request);
+
+    // Returns true if a GET request for url is already in progress, or can
+    // be served from the cache without contacting the server.
+    bool isAvailable(const URL& url);
+    void resize(HttpCache* cache, unsigned long long length);
     void remove(HttpCache* cache);
 
+    void retainFile(const std::string& path);
+    void releaseFile(const std::string& path);
+    void removeFile(const std::string& path);
+
+    // Loads the persistent cache index from the specified cache directory.
+    // Once opened, the index is written back by save() and close(), and by
+    // flush() at most every saveInterval seconds so that a crash loses only
+    // the entries stored since then.
+    bool open(const std::string& path);
+    bool save();
+    bool flush();
+    void close();
+
+    void setSaveInterval(unsigned seconds) {
+        saveInterval = seconds;
+    }
+    unsigned getSaveInterval() const {
+        return saveInterval;
+    }
+
     void dump();
 
     static HttpCacheManager& getInstance()
@@ -17,6 +17,7 @@
 #include "HTTPConnection.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <boost/bind.hpp>
 
@@ -46,12 +47,21 @@ const char* HttpConnection::States[] = {
 HttpConnection::HttpConnection(const std::string& protocol, const std::string& hostname, const std::string& port) :
     state(Closed),
     retryCount(0),
+    persistent(false),
+    serial(false),
+    writing(false),
     protocol(protocol),
     hostname(hostname),
     port(port),
     socket(HttpConnectionManager::getIOService()),
     context(boost::asio::ssl::context::sslv23),
     secureSocket(socket, context),
+    idleTimer(HttpConnectionManager::getIOService()),
+    nextEndpoint(0),
+    attemptTimer(HttpConnectionManager::getIOService()),
+    contentCoding(HttpResponseMessage::IDENTITY),
+    rawDeflate(false),
+    streamEnded(false),
     current(0)
 {
     if (protocol == "https:") {
@@ -73,14 +83,68 @@ void HttpConnection::sendRequest()
     asyncWrite(request, boost::bind(&HttpConnection::handleWriteRequest, this, boost::asio::placeholders::error));
 }
 
+bool HttpConnection::canPipeline(const HttpRequestPtr& next) const
+{
+    size_t depth = HttpConnectionManager::getInstance().getPipelineDepth();
+    if (depth <= 1 || serial || !persistent || writing || !current || !requests.empty())
+        return false;
+    // The request of current must have been written.
+    if (state < ReadStatusLine || ReadTrailer < state)
+        return false;
+    if (depth <= pipeline.size() + 1)
+        return false;
+    return isIdempotent(current) && isIdempotent(next);
+}
+
+void HttpConnection::sendPipelined(const HttpRequestPtr& next)
+{
+    if (3 <= getLogLevel())
+        std::cerr << __func__ << ' ' << next->getRequestMessage().toString() << '\n';
+
+    pipeline.push_back(next);
+    writing = true;
+    std::ostream stream(&request);
+    stream << next->getRequestMessage().toString();
+    stream << "\r\n";
+    asyncWrite(request, boost::bind(&HttpConnection::handleWritePipelined, this, boost::asio::placeholders::error));
+}
+
 void HttpConnection::done(HttpConnectionManager* manager, bool error)
 {
     line.clear();
+    endContentCoding();
     if (current) {
         HttpRequestPtr request = current;
         current.reset();
         manager->complete(request, error);
     }
+    if (!error && !pipeline.empty() && state != Closed) {
+        // The next request has been sent already; readNext() reads its response.
+        retryCount = 0;
+        current = pipeline.front();
+        pipeline.pop_front();
+        state = ReadStatusLine;
+        return;
+    }
+    if (!pipeline.empty()) {
+        // The connection has been closed in the middle of the pipeline. Send
+        // the rest of the pipelined requests again one by one.
+        if (3 <= getLogLevel())
+            std::cerr << __func__ << ": pipeline broken: " << hostname << ' ' << pipeline.size() << '\n';
+        if (state != Closed)
+            close();
+        serial = true;
+        if (error) {
+            while (!requests.empty()) {
+                current = requests.front();
+                requests.pop_front();
+                manager->complete(current, error);
+            }
+            current.reset();
+            error = false;
+        }
+        requests.splice(requests.begin(), pipeline);
+    }
     if (!error) {
         retryCount = 0;
         if (!requests.empty()) {
@@ -97,13 +161,34 @@ void HttpConnection::done(HttpConnectionManager* manager, bool error)
         }
         current.reset();
     }
+    if (!current && !manager->dispatch(this) && manager->getIdleTimeout()) {
+        idleTimer.expires_from_now(boost::posix_time::seconds(manager->getIdleTimeout()));
+        idleTimer.async_wait(boost::bind(&HttpConnection::handleIdleTimeout, this, boost::asio::placeholders::error));
+    }
+}
+
+void HttpConnection::handleIdleTimeout(const boost::system::error_code& err)
+{
+    if (err == boost::asio::error::operation_aborted)
+        return;
+    if (3 <= getLogLevel())
+        std::cerr << __func__ << ' ' << hostname << ' ' << States[state] << '\n';
+    if (!isIdle())
+        return;
+    if (state != Closed)
+        close();
+    HttpConnectionManager::getInstance().release(this);
 }
 
 void HttpConnection::close()
 {
     state = Closed;
     line.clear();
+    endContentCoding();
     retryCount = 0;
+    persistent = false;
+    writing = false;
+    cancelAttempts();
     socket.close();
     request.consume(request.size());
     response.consume(response.size());
@@ -114,38 +199,123 @@ void HttpConnection::retry()
     if (3 <= getLogLevel())
         std::cerr << __func__ << ' ' << current->getURL() << ": " << retryCount + 1 << '\n';
 
-    int count = retryCount;
-    close();
-    retryCount = count + 1;
-    if (retryCount < MaxRetryCount) {
-        HttpRequestPtr request = current;
-        current.reset();
-        send(request);
-    } else
+    if (retryCount + 1 < MaxRetryCount) {
+        if (!pipeline.empty())
+            serial = true;  // Fall back to the serial mode.
+        resend(retryCount + 1);
+    } else {
+        close();
         HttpConnectionManager::getInstance().done(this, true);
+    }
+}
+
+// Closes the socket and sends current and the pipelined requests again
+// over a new one, keeping count as the retry count.
+void HttpConnection::resend(int count)
+{
+    close();
+    retryCount = count;
+    requests.splice(requests.begin(), pipeline);
+    HttpRequestPtr request = current;
+    current.reset();
+    send(request);
 }
 
-void HttpConnection::handleResolve(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpointIterator)
+namespace {
+
+// Alternates the address families of the endpoints, keeping the order within
+// each family; cf. RFC 6555.
+EndpointList interleave(const EndpointList& endpoints)
+{
+    if (endpoints.empty())
+        return endpoints;
+    EndpointList first;
+    EndpointList second;
+    bool v6 = endpoints.front().address().is_v6();
+    for (auto i = endpoints.begin(); i != endpoints.end(); ++i) {
+        if (i->address().is_v6() == v6)
+            first.push_back(*i);
+        else
+            second.push_back(*i);
+    }
+    EndpointList result;
+    for (size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+        if (i < first.size())
+            result.push_back(first[i]);
+        if (i < second.size())
+            result.push_back(second[i]);
+    }
+    return result;
+}
+
+}  // namespace
+
+void HttpConnection::handleResolve(const boost::system::error_code& err, const EndpointList& resolved)
 {
     if (3 <= getLogLevel())
         std::cerr << __func__ << ' ' << err << '\n';
 
-    if (!err) {
+    if (state != Resolving)
+        return;
+    if (!err && !resolved.empty()) {
         state = Resolved;
-        boost::asio::ip::tcp::endpoint endpoint = *endpointIterator;
-        socket.async_connect(endpoint, boost::bind(&HttpConnection::handleConnect, this, boost::asio::placeholders::error, ++endpointIterator));
+        endpoints = interleave(resolved);
+        nextEndpoint = 0;
+        startAttempt();
         return;
     }
     HttpConnectionManager::getInstance().done(this, true);
 }
 
-void HttpConnection::handleConnect(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpointIterator)
+// Starts connecting to the next endpoint. Unless the attempt completes
+// within ConnectionAttemptDelay, another attempt is started in parallel.
+bool HttpConnection::startAttempt()
+{
+    if (endpoints.size() <= nextEndpoint)
+        return false;
+    SocketPtr attempt(std::make_shared<boost::asio::ip::tcp::socket>(HttpConnectionManager::getIOService()));
+    attempts.push_back(attempt);
+    attempt->async_connect(endpoints[nextEndpoint++], boost::bind(&HttpConnection::handleConnect, this, boost::asio::placeholders::error, attempt));
+    if (nextEndpoint < endpoints.size()) {
+        attemptTimer.expires_from_now(boost::posix_time::milliseconds(ConnectionAttemptDelay));
+        attemptTimer.async_wait(boost::bind(&HttpConnection::handleAttemptTimeout, this, boost::asio::placeholders::error));
+    }
+    return true;
+}
+
+void HttpConnection::cancelAttempts()
+{
+    attemptTimer.cancel();
+    for (auto i = attempts.begin(); i != attempts.end(); ++i) {
+        boost::system::error_code ignored;
+        (*i)->close(ignored);
+    }
+    attempts.clear();
+    endpoints.clear();
+    nextEndpoint = 0;
+}
+
+void HttpConnection::handleAttemptTimeout(const boost::system::error_code& err)
+{
+    if (err == boost::asio::error::operation_aborted || state != Resolved)
+        return;
+    startAttempt();
+}
+
+void HttpConnection::handleConnect(const boost::system::error_code& err, SocketPtr attempt)
 {
     if (3 <= getLogLevel())
         std::cerr << __func__ << ' ' << err << '\n';
 
+    auto found = std::find(attempts.begin(), attempts.end(), attempt);
+    if (state != Resolved || found == attempts.end())
+        return;  // canceled
+    attempts.erase(found);
+
     if (!err) {
-        if (protocol == "https:" && state == Resolved) {
+        cancelAttempts();
+        socket = std::move(*attempt);
+        if (protocol == "https:") {
             state = Handshaking;
             secureSocket.async_handshake(boost::asio::ssl::stream_base::client, boost::bind(&HttpConnection::handleHandshake, this, boost::asio::placeholders::error));
         } else {
@@ -159,13 +329,13 @@ void HttpConnection::handleConnect(const boost::system::error_code& err, boost::
         }
         return;
     }
-    if (endpointIterator != boost::asio::ip::tcp::resolver::iterator()) {
-        close();
-        boost::asio::ip::tcp::endpoint endpoint = *endpointIterator;
-        socket.async_connect(endpoint, boost::bind(&HttpConnection::handleConnect, this, boost::asio::placeholders::error, ++endpointIterator));
+    // Try the next endpoint at once rather than waiting for the timer.
+    if (startAttempt() || !attempts.empty())
         return;
-    }
-    HttpConnectionManager::getInstance().done(this, true);
+    cancelAttempts();
+    HttpConnectionManager& manager(HttpConnectionManager::getInstance());
+    manager.flushHost(hostname, port);
+    manager.done(this, true);
 }
 
 void HttpConnection::handleHandshake(const boost::system::error_code& err)
@@ -240,6 +410,18 @@ void HttpConnection::handleWriteRequest(const boost::system::error_code& err)
     HttpConnectionManager::getInstance().done(this, true);
 }
 
+void HttpConnection::handleWritePipelined(const boost::system::error_code& err)
+{
+    if (3 <= getLogLevel())
+        std::cerr << __func__ << ' ' << err <<  '\n';
+
+    writing = false;
+    // Upon error, the read operation in progress for current fails as well,
+    // and then the pipelined requests are sent again.
+    if (!err && state != Closed)
+        HttpConnectionManager::getInstance().dispatch(this, true);
+}
+
 void HttpConnection::readStatusLine(const boost::system::error_code& err)
 {
     if (err && err != boost::asio::error::eof) {
@@ -337,12 +519,29 @@ void HttpConnection::readHead(const boost::system::error_code& err)
         line.clear();
     }
 
+    // Note persistent is updated by every response, as a later response can
+    // close the connection.
+    persistent = responseMessage.getVersion() == 11 && !responseMessage.isConnectionClose();
+
+    // The content is always stored decoded so that the cached responses
+    // are consistent regardless of the content coding.
+    int coding = responseMessage.getContentCoding();
+    bool hasContentLength = responseMessage.hasContentLengthHeader();
+    contentLength = responseMessage.getContentLength();
+    if (coding == HttpResponseMessage::GZIP || coding == HttpResponseMessage::DEFLATE)
+        responseMessage.clearContentCoding();
+
     // TODO: handle every status code
     switch (responseMessage.getStatus()) {
     case 304:   // Not Modified
         break;
     default:
         octetCount = 0;
+        if (!beginContentCoding(coding)) {
+            close();
+            HttpConnectionManager::getInstance().done(this, true);
+            return;
+        }
         if (responseMessage.isChunked()) {
             chunkCRLF = 0;
             contentLength = 0;
@@ -350,8 +549,7 @@ void HttpConnection::readHead(const boost::system::error_code& err)
             readChunk(err);
             return;
         }
-        contentLength = responseMessage.getContentLength();
-        if (responseMessage.hasContentLengthHeader() && 0 < contentLength) {
+        if (hasContentLength && 0 < contentLength) {
             state = ReadContent;
             readContent(err);
             return;
@@ -359,11 +557,26 @@ void HttpConnection::readHead(const boost::system::error_code& err)
         break;
     }
 
+    if (err)
+        close();
     HttpConnectionManager::getInstance().done(this, false);
-    if (!err) {
+    if (!err)
+        readNext();
+}
+
+// Reads the response to the next pipelined request if any. Otherwise waits
+// for the server to close the connection.
+void HttpConnection::readNext()
+{
+    if (state == Resolving)  // reconnecting to resend the broken pipeline
+        return;
+    if (state != ReadStatusLine) {
         state = CloseWait;
         asyncRead(response, boost::asio::transfer_at_least(1), boost::bind(&HttpConnection::handleRead, this, boost::asio::placeholders::error));
-    }
+    } else if (0 < response.size())
+        readStatusLine(boost::system::error_code());
+    else
+        asyncRead(response, boost::asio::transfer_at_least(1), boost::bind(&HttpConnection::handleRead, this, boost::asio::placeholders::error));
 }
 
 void HttpConnection::readContent(const boost::system::error_code& err)
@@ -376,15 +589,16 @@ void HttpConnection::readContent(const boost::system::error_code& err)
         }
         bool completed = false;
         if (0 < response.size()) {
-            if (!contentLength) {
-                octetCount += response.size();
-                content << &response;
-            } else {
-                unsigned long long length = std::min(static_cast<unsigned long long>(response.size()), contentLength - octetCount);
-                content.write(boost::asio::buffer_cast<const char*>(response.data()), length);
-                response.consume(length);
-                octetCount += length;
+            unsigned long long length = response.size();
+            if (contentLength)
+                length = std::min(length, contentLength - octetCount);
+            if (!writeContent(content, boost::asio::buffer_cast<const char*>(response.data()), length)) {
+                close();
+                HttpConnectionManager::getInstance().done(this, true);
+                return;
             }
+            response.consume(length);
+            octetCount += length;
             if (contentLength <= octetCount)
                 completed = true;
         }
@@ -395,17 +609,116 @@ void HttpConnection::readContent(const boost::system::error_code& err)
         content.flush();
     }
     if (err == boost::asio::error::eof) {
+        bool complete = isContentComplete();
         close();
         if (contentLength < octetCount) {
             contentLength = octetCount;
             // TODO: set Content-length:
         }
-        HttpConnectionManager::getInstance().done(this, octetCount < contentLength);
+        HttpConnectionManager::getInstance().done(this, octetCount < contentLength || !complete);
+        return;
+    }
+    if (!err && !isContentComplete()) {
+        // A truncated compressed content must not be cached as it is.
+        close();
+        HttpConnectionManager::getInstance().done(this, true);
         return;
     }
     HttpConnectionManager::getInstance().done(this, err);
-    state = CloseWait;
-    asyncRead(response, boost::asio::transfer_at_least(1), boost::bind(&HttpConnection::handleRead, this, boost::asio::placeholders::error));
+    readNext();
+}
+
+bool HttpConnection::beginContentCoding(int coding)
+{
+    endContentCoding();
+    if (coding != HttpResponseMessage::GZIP && coding != HttpResponseMessage::DEFLATE)
+        return true;
+    memset(&zstream, 0, sizeof zstream);
+    // 15 + 32 accepts both the gzip and the zlib formats.
+    if (inflateInit2(&zstream, 15 + 32) != Z_OK)
+        return false;
+    contentCoding = coding;
+    rawDeflate = false;
+    zlibHeader.clear();
+    streamEnded = false;
+    return true;
+}
+
+// Returns true if the two bytes at header can start the zlib format.
+bool HttpConnection::isZlibHeader(const std::string& header)
+{
+    unsigned cmf = static_cast<unsigned char>(header[0]);
+    unsigned flg = static_cast<unsigned char>(header[1]);
+    return (cmf & 0x0f) == Z_DEFLATED && (cmf >> 4) <= 7 && (cmf * 256 + flg) % 31 == 0;
+}
+
+void HttpConnection::endContentCoding()
+{
+    if (contentCoding == HttpResponseMessage::IDENTITY)
+        return;
+    inflateEnd(&zstream);
+    contentCoding = HttpResponseMessage::IDENTITY;
+}
+
+// Writes the received content into the content file, inflating it as it
+// arrives if the content has been compressed. The content file is flushed
+// each time so that the content can be read while it is loading.
+bool HttpConnection::writeContent(std::fstream& content, const char* data, size_t length)
+{
+    if (contentCoding == HttpResponseMessage::IDENTITY) {
+        content.write(data, length);
+        content.flush();
+        current->progress(length);
+        return true;
+    }
+    unsigned long long written = 0;
+    if (contentCoding == HttpResponseMessage::DEFLATE && zlibHeader.length() < 2) {
+        // Some servers send raw deflate data without the zlib header. Tell
+        // them apart by the first two bytes before inflating anything.
+        size_t count = std::min(length, 2 - zlibHeader.length());
+        zlibHeader.append(data, count);
+        data += count;
+        length -= count;
+        if (zlibHeader.length() < 2)
+            return true;
+        if (!isZlibHeader(zlibHeader)) {
+            if (inflateReset2(&zstream, -15) != Z_OK)
+                return false;
+            rawDeflate = true;
+        }
+        if (!inflateContent(content, zlibHeader.data(), zlibHeader.length(), written))
+            return false;
+    }
+    if (0 < length && !inflateContent(content, data, length, written))
+        return false;
+    content.flush();
+    current->progress(written);
+    return true;
+}
+
+// Inflates length bytes at data into content, adding the number of the
+// bytes written to written.
+bool HttpConnection::inflateContent(std::fstream& content, const char* data, size_t length, unsigned long long& written)
+{
+    char buffer[16384];
+    zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zstream.avail_in = length;
+    for (;;) {
+        zstream.next_out = reinterpret_cast<Bytef*>(buffer);
+        zstream.avail_out = sizeof buffer;
+        int result = inflate(&zstream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+            return false;
+        content.write(buffer, sizeof buffer - zstream.avail_out);
+        written += sizeof buffer - zstream.avail_out;
+        if (result == Z_STREAM_END) {
+            streamEnded = true;
+            break;
+        }
+        if (zstream.avail_out != 0)
+            break;
+    }
+    return true;
 }
 
 void HttpConnection::readChunk(const boost::system::error_code& err)
@@ -446,7 +759,11 @@ void HttpConnection::readChunk(const boost::system::error_code& err)
             if (!completed) {
                 if (0 < response.size() && octetCount < contentLength) {
                     unsigned long long length = std::min(static_cast<unsigned long long>(response.size()), contentLength - octetCount);
-                    content.write(boost::asio::buffer_cast<const char*>(response.data()), length);
+                    if (!writeContent(content, boost::asio::buffer_cast<const char*>(response.data()), length)) {
+                        HttpConnectionManager::getInstance().done(this, true);
+                        close();
+                        return;
+                    }
                     response.consume(length);
                     octetCount += length;
                 }
@@ -488,14 +805,18 @@ void HttpConnection::readTrailer(const boost::system::error_code& err)
             int c = response.sbumpc();
             if (c == '\n') {
                 if (++chunkCRLF == 2) {
+                    if (!isContentComplete()) {
+                        // A truncated compressed content must not be cached as it is.
+                        close();
+                        HttpConnectionManager::getInstance().done(this, true);
+                        return;
+                    }
                     // TODO: set Content-length:
                     HttpConnectionManager::getInstance().done(this, false);
                     if (err)
                         close();
-                    else {
-                        state = CloseWait;
-                        asyncRead(response, boost::asio::transfer_at_least(1), boost::bind(&HttpConnection::handleRead, this, boost::asio::placeholders::error));
-                    }
+                    else
+                        readNext();
                     return;
                 }
             } else if (c != '\r')
@@ -515,10 +836,14 @@ void HttpConnection::send(const HttpRequestPtr& request)
 {
     if (current) {
         assert(current != request);
-        requests.push_back(request);
+        if (canPipeline(request))
+            sendPipelined(request);
+        else
+            requests.push_back(request);
         return;
     }
     current = request;
+    idleTimer.cancel();
 
     if (socket.is_open()) {
         sendRequest();
@@ -526,15 +851,20 @@ void HttpConnection::send(const HttpRequestPtr& request)
     }
 
     state = Resolving;
-    boost::asio::ip::tcp::resolver::query query(hostname, port);
-    HttpConnectionManager::getInstance().resolve(query,
-                                                 boost::bind(&HttpConnection::handleResolve, this,
-                                                             boost::asio::placeholders::error,
-                                                             boost::asio::placeholders::iterator));
+    HttpConnectionManager::getInstance().resolve(hostname, port, boost::bind(&HttpConnection::handleResolve, this, _1, _2));
 }
 
 void HttpConnection::abort(const HttpRequestPtr& request)
 {
+    if (std::find(pipeline.begin(), pipeline.end(), request) != pipeline.end()) {
+        // The responses that follow cannot be matched with the requests any
+        // more; send current and the rest of the pipeline again.
+        // The server has not failed, so that the retry count is kept.
+        pipeline.remove(request);
+        request->notify(true);
+        resend(retryCount);
+        return;
+    }
     if (current != request) {
         requests.remove(request);
         request->notify(true);
@@ -546,14 +876,37 @@ void HttpConnection::abort(const HttpRequestPtr& request)
 
 void HttpConnection::dump()
 {
-    std::cout << "HttpConnection: " << protocol << ' ' << hostname << ' ' << States[state] << ' ' << requests.size() << '\n';
+    std::cout << "HttpConnection: " << protocol << ' ' << hostname << ' ' << States[state] << ' ' << requests.size() << ' ' << pipeline.size() << '\n';
 }
 
-HttpConnection* HttpConnectionManager::getConnection(const std::string& protocol, const std::string& hostname, const std::string& port)
+HttpConnection* HttpConnectionManager::getConnection(const std::string& protocol, const std::string& hostname, const std::string& port, const HttpRequestPtr& request)
 {
+    size_t count = 0;
+    HttpConnection* idle = 0;
     for (auto i = connections.begin(); i != connections.end(); ++i) {
-        if ((*i)->protocol == protocol && (*i)->hostname == hostname && (*i)->port == port)
-            return *i;
+        HttpConnection* conn = *i;
+        if (conn->protocol != protocol || conn->hostname != hostname || conn->port != port)
+            continue;
+        ++count;
+        // Prefer the connection that keeps its socket open.
+        if (conn->isIdle() && (!idle || (!idle->socket.is_open() && conn->socket.is_open())))
+            idle = conn;
+    }
+    if (idle)
+        return idle;
+    if (maxConnectionsPerHost <= count) {
+        if (!request || pipelineDepth <= 1)
+            return 0;
+        // Choose the connection with the shortest pipeline.
+        HttpConnection* shortest = 0;
+        for (auto i = connections.begin(); i != connections.end(); ++i) {
+            HttpConnection* conn = *i;
+            if (conn->protocol != protocol || conn->hostname != hostname || conn->port != port)
+                continue;
+            if (conn->canPipeline(request) && (!shortest || conn->pipeline.size() < shortest->pipeline.size()))
+                shortest = conn;
+        }
+        return shortest;
     }
     HttpConnection* c = new(std::nothrow) HttpConnection(protocol, hostname, port);
     if (c)
@@ -561,6 +914,100 @@ HttpConnection* HttpConnectionManager::getConnection(const std::string& protocol
     return c;
 }
 
+void HttpConnectionManager::resolve(const std::string& hostname, const std::string& port, ResolveHandler handler)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    std::string key(hostname + ':' + port);
+    auto found = hosts.find(key);
+    if (found != hosts.end()) {
+        if (time(0) < found->second.expires) {
+            ioService.post(boost::bind(handler, boost::system::error_code(), found->second.endpoints));
+            return;
+        }
+        hosts.erase(found);
+    }
+    boost::asio::ip::tcp::resolver::query query(hostname, port);
+    resolver.async_resolve(query, boost::bind(&HttpConnectionManager::handleResolve, this,
+                                              boost::asio::placeholders::error,
+                                              boost::asio::placeholders::iterator,
+                                              key, handler));
+}
+
+void HttpConnectionManager::handleResolve(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpointIterator,
+                                          const std::string& key, ResolveHandler handler)
+{
+    EndpointList endpoints;
+    if (!err) {
+        for (; endpointIterator != boost::asio::ip::tcp::resolver::iterator(); ++endpointIterator)
+            endpoints.push_back(*endpointIterator);
+        if (!endpoints.empty() && hostCacheTTL) {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+            HostEntry& entry(hosts[key]);
+            entry.endpoints = endpoints;
+            entry.expires = time(0) + hostCacheTTL;
+        }
+    }
+    handler(err, endpoints);
+}
+
+void HttpConnectionManager::flushHost(const std::string& hostname, const std::string& port)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    hosts.erase(hostname + ':' + port);
+}
+
+void HttpConnectionManager::setHost(const std::string& hostname, const std::string& port, const EndpointList& endpoints)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    HostEntry& entry(hosts[hostname + ':' + port]);
+    entry.endpoints = endpoints;
+    entry.expires = time(0) + hostCacheTTL;
+}
+
+HttpConnection* HttpConnectionManager::findConnection(const HttpRequestPtr& request)
+{
+    for (auto i = connections.begin(); i != connections.end(); ++i) {
+        if ((*i)->hasRequest(request))
+            return *i;
+    }
+    return 0;
+}
+
+// Removes conn, which has been closed after staying idle, so that the
+// connections to the origins visited before do not accumulate.
+void HttpConnectionManager::release(HttpConnection* conn)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    if (!conn->isIdle())
+        return;
+    connections.remove(conn);
+    // Let the handlers canceled by close() run before conn is deleted.
+    ioService.post([conn]() { delete conn; });
+}
+
+// Sends the next pending request for the origin of conn over conn, which
+// has just become idle, or can pipeline another request if pipelined is true.
+bool HttpConnectionManager::dispatch(HttpConnection* conn, bool pipelined)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    auto found = pending.find(getOrigin(conn->protocol, conn->hostname, conn->port));
+    if (found == pending.end())
+        return false;
+    if (pipelined && !conn->canPipeline(found->second.front()))
+        return false;
+    HttpRequestPtr request = found->second.front();
+    found->second.pop_front();
+    if (found->second.empty())
+        pending.erase(found);
+    conn->send(request);
+    return true;
+}
+
 void HttpConnectionManager::send(const HttpRequestPtr& request)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex);
@@ -569,9 +1016,11 @@ void HttpConnectionManager::send(const HttpRequestPtr& request)
     std::string protocol = uri.getProtocol();
     std::string hostname = uri.getHostname();
     std::string port = uri.getPort();
-    HttpConnection* conn = getConnection(protocol, hostname, port);
-    if (!conn)
+    HttpConnection* conn = getConnection(protocol, hostname, port, request);
+    if (!conn) {
+        pending[getOrigin(protocol, hostname, port)].push_back(request);
         return;
+    }
     conn->send(request);
 }
 
@@ -581,13 +1030,18 @@ void HttpConnectionManager::abort(const HttpRequestPtr& request)
 
     if (request->getReadyState() != HttpRequest::COMPLETE) {
         if (!request->cache || !request->cache->abort(request)) {
-            URI uri(request->getURL());
-            std::string protocol = uri.getProtocol();
-            std::string hostname = uri.getHostname();
-            std::string port = uri.getPort();
-            HttpConnection* conn = getConnection(protocol, hostname, port);
-            if (conn)
+            if (HttpConnection* conn = findConnection(request))
                 conn->abort(request);
+            else {
+                URI uri(request->getURL());
+                auto found = pending.find(getOrigin(uri.getProtocol(), uri.getHostname(), uri.getPort()));
+                if (found != pending.end()) {
+                    found->second.remove(request);
+                    if (found->second.empty())
+                        pending.erase(found);
+                    request->notify(true);
+                }
+            }
         }
     }
     if (request->getReadyState() == HttpRequest::COMPLETE)
@@ -624,6 +1078,7 @@ void HttpConnectionManager::poll()
 {
     while (HttpRequestPtr request = getCompleted())
         request->notify();
+    HttpCacheManager::getInstance().flush();
 }
 
 void HttpConnectionManager::operator()()
@@ -636,6 +1091,8 @@ void HttpConnectionManager::dump()
     HttpConnectionManager& instance(getInstance());
     for (auto i = instance.connections.begin(); i != instance.connections.end(); ++i)
         (*i)->dump();
+    for (auto i = instance.pending.begin(); i != instance.pending.end(); ++i)
+        std::cout << "pending: " << i->first << ' ' << i->second.size() << '\n';
     std::cout << "completed: " << instance.completed.size() << '\n';
 }
 
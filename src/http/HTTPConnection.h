@@ -17,50 +17,131 @@
 #ifndef ES_HTTP_CONNECTION_H
 #define ES_HTTP_CONNECTION_H
 
+#include <algorithm>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
+#include <zlib.h>
+
 #include "http/HTTPCache.h"
 
 namespace org { namespace w3c { namespace dom { namespace bootstrap {
 
 class HttpConnection;
 
+typedef std::vector<boost::asio::ip::tcp::endpoint> EndpointList;
+typedef boost::function<void (const boost::system::error_code&, const EndpointList&)> ResolveHandler;
+
 class HttpConnectionManager
 {
+    friend class HttpConnection;
+
+    static const size_t DefaultMaxConnectionsPerHost = 6;
+    static const unsigned DefaultIdleTimeout = 30;  // in seconds
+    static const unsigned DefaultHostCacheTTL = 60;  // in seconds
+
+    struct HostEntry
+    {
+        EndpointList endpoints;
+        long long expires;
+    };
+
     std::recursive_mutex mutex;
     std::list<HttpConnection*> connections;
     std::list<HttpRequestPtr> completed;
 
+    // The requests waiting for an idle connection, keyed by origin
+    std::map<std::string, std::list<HttpRequestPtr>> pending;
+
+    size_t maxConnectionsPerHost;
+    unsigned idleTimeout;
+    size_t pipelineDepth;  // 0 or 1 to disable pipelining
+
+    // The resolved endpoints keyed by hostname:port
+    std::map<std::string, HostEntry> hosts;
+    unsigned hostCacheTTL;
+
     boost::asio::io_service ioService;
     boost::asio::ip::tcp::resolver resolver;
     boost::asio::io_service::work work;
 
     HttpRequestPtr getCompleted();
 
+    static std::string getOrigin(const std::string& protocol, const std::string& hostname, const std::string& port) {
+        return protocol + "//" + hostname + ':' + port;
+    }
+    HttpConnection* findConnection(const HttpRequestPtr& request);
+    bool dispatch(HttpConnection* conn, bool pipelined = false);
+    void release(HttpConnection* conn);
+
+    void handleResolve(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpointIterator,
+                       const std::string& key, ResolveHandler handler);
+
 public:
     HttpConnectionManager() :
+        maxConnectionsPerHost(DefaultMaxConnectionsPerHost),
+        idleTimeout(DefaultIdleTimeout),
+        pipelineDepth(0),
+        hostCacheTTL(DefaultHostCacheTTL),
         resolver(ioService),
         work(ioService)
     {
     }
 
-    HttpConnection* getConnection(const std::string& protocol, const std::string& hostname, const std::string& port);
+    void setMaxConnectionsPerHost(size_t count) {
+        maxConnectionsPerHost = std::max(count, static_cast<size_t>(1));
+    }
+    size_t getMaxConnectionsPerHost() const {
+        return maxConnectionsPerHost;
+    }
+    void setIdleTimeout(unsigned seconds) {
+        idleTimeout = seconds;
+    }
+    unsigned getIdleTimeout() const {
+        return idleTimeout;
+    }
+    // Enables HTTP/1.1 pipelining of up to depth GET and HEAD requests per
+    // connection.
+    void setPipelineDepth(size_t depth) {
+        pipelineDepth = depth;
+    }
+    size_t getPipelineDepth() const {
+        return pipelineDepth;
+    }
+
+    // Returns an idle connection to the specified origin, or a new one if
+    // the number of the connections to the origin is less than
+    // maxConnectionsPerHost. Otherwise, returns a connection over which
+    // request can be pipelined, or 0.
+    HttpConnection* getConnection(const std::string& protocol, const std::string& hostname, const std::string& port, const HttpRequestPtr& request = 0);
     void send(const HttpRequestPtr& request);
     void abort(const HttpRequestPtr& request);
     void done(HttpConnection* conn, bool error);
     void complete(const HttpRequestPtr& request, bool error);
     void poll();
 
-    template <typename ResolveHandler>
-    void resolve(const boost::asio::ip::tcp::resolver::query& q, ResolveHandler handler) {
-        resolver.async_resolve(q,handler);
+    void setHostCacheTTL(unsigned seconds) {
+        hostCacheTTL = seconds;
+    }
+    unsigned getHostCacheTTL() const {
+        return hostCacheTTL;
     }
 
+    // Resolves hostname asynchronously unless it has been resolved within
+    // the last hostCacheTTL seconds.
+    void resolve(const std::string& hostname, const std::string& port, ResolveHandler handler);
+    void flushHost(const std::string& hostname, const std::string& port);
+    // Registers the endpoints of hostname as if they have just been
+    // resolved; used as a resolver stub for testing.
+    void setHost(const std::string& hostname, const std::string& port, const EndpointList& endpoints);
+
     void operator()();
     void stop() {
         ioService.stop();
@@ -100,9 +181,13 @@ class HttpConnection
     static const char* States[];
 
     static const int MaxRetryCount = 3;
+    static const int ConnectionAttemptDelay = 250;  // in milliseconds
 
     int state;
     int retryCount;
+    bool persistent;  // true if the server keeps the connection alive
+    bool serial;      // true if the server failed in the middle of the pipeline
+    bool writing;     // true while a pipelined request is being written
     std::string line;  // line buffer
 
     std::string protocol;
@@ -117,6 +202,17 @@ class HttpConnection
     boost::asio::ssl::context context;
     boost::asio::ssl::stream<boost::asio::ip::tcp::socket&> secureSocket;
 
+    // closes the keep-alive socket after staying idle for a while
+    boost::asio::deadline_timer idleTimer;
+
+    // Connection attempts racing against each other; the first socket
+    // connected is moved to socket.
+    typedef std::shared_ptr<boost::asio::ip::tcp::socket> SocketPtr;
+    EndpointList endpoints;
+    size_t nextEndpoint;
+    std::list<SocketPtr> attempts;
+    boost::asio::deadline_timer attemptTimer;
+
     unsigned long long octetCount;
     unsigned long long contentLength;
 
@@ -124,15 +220,32 @@ class HttpConnection
     unsigned long long chunkLength;
     int chunkCRLF;
 
+    // gzip or deflate content coding
+    int contentCoding;
+    bool rawDeflate;
+    std::string zlibHeader;  // the first two bytes of the deflate content
+    bool streamEnded;   // true once the compressed stream has been fully inflated
+    z_stream zstream;
+
     std::list<HttpRequestPtr> requests;
     HttpRequestPtr current;
 
+    // The requests that have been written after current, and are waiting
+    // for the responses in order.
+    std::list<HttpRequestPtr> pipeline;
+
     void sendRequest();
+    void sendPipelined(const HttpRequestPtr& request);
+
+    bool startAttempt();
+    void cancelAttempts();
 
-    void handleResolve(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpointIterator);
-    void handleConnect(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpointIterator);
+    void handleResolve(const boost::system::error_code& err, const EndpointList& endpoints);
+    void handleAttemptTimeout(const boost::system::error_code& err);
+    void handleConnect(const boost::system::error_code& err, SocketPtr attempt);
     void handleHandshake(const boost::system::error_code& err);
     void handleWriteRequest(const boost::system::error_code& err);
+    void handleWritePipelined(const boost::system::error_code& err);
     void handleRead(const boost::system::error_code& err);
 
     void readStatusLine(const boost::system::error_code& err);
@@ -140,9 +253,37 @@ class HttpConnection
     void readContent(const boost::system::error_code& err);
     void readChunk(const boost::system::error_code& err);
     void readTrailer(const boost::system::error_code& err);
+    void readNext();
+
+    bool beginContentCoding(int coding);
+    void endContentCoding();
+    bool writeContent(std::fstream& content, const char* data, size_t length);
+    bool inflateContent(std::fstream& content, const char* data, size_t length, unsigned long long& written);
+    static bool isZlibHeader(const std::string& header);
+    // Returns false if the compressed content has ended prematurely.
+    bool isContentComplete() const {
+        return contentCoding == HttpResponseMessage::IDENTITY || streamEnded;
+    }
+
+    void handleIdleTimeout(const boost::system::error_code& err);
+
+    bool isIdle() const {
+        return !current && requests.empty() && pipeline.empty();
+    }
+    bool hasRequest(const HttpRequestPtr& request) const {
+        return current == request ||
+               std::find(requests.begin(), requests.end(), request) != requests.end() ||
+               std::find(pipeline.begin(), pipeline.end(), request) != pipeline.end();
+    }
+    static bool isIdempotent(const HttpRequestPtr& request) {
+        int code = request->getRequestMessage().getMethodCode();
+        return code == HttpRequestMessage::GET || code == HttpRequestMessage::HEAD;
+    }
+    bool canPipeline(const HttpRequestPtr& request) const;
 
     void close();
     void retry();
+    void resend(int count);
 
     void send(const HttpRequestPtr& request);
     void abort(const HttpRequestPtr& request);
@@ -71,12 +71,61 @@ std::fstream& HttpRequest::getContent()
     int fd = mkstemp(tempPath);
     if (fd == -1)
         return content;
+    releaseFile();
     filePath = tempPath;
     content.open(tempPath, std::ios_base::trunc | std::ios_base::in | std::ios_base::out | std::ios::binary);
     close(fd);
     return content;
 }
 
+// Releases the body file shared with the cache, if any, so that the cache
+// can remove the file once it has been evicted.
+void HttpRequest::releaseFile()
+{
+    if (flags & CACHED) {
+        flags &= ~CACHED;
+        HttpCacheManager::getInstance().releaseFile(filePath);
+    }
+}
+
+void HttpRequest::progress(unsigned long long length)
+{
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        loaded += length;
+        // The content of a successful response can be read while it is loading.
+        if (readyState == OPENED && response.getStatus() / 100 == 2)
+            readyState = LOADING;
+    }
+    contentCondition.notify_all();
+}
+
+// Updates readyState, waking up the threads blocked in waitForContent().
+void HttpRequest::setReadyState(unsigned short state)
+{
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        readyState = state;
+    }
+    contentCondition.notify_all();
+}
+
+void HttpRequest::waitForContent(unsigned long long length, const std::atomic_bool* cancelled)
+{
+    std::unique_lock<std::mutex> lock(contentMutex);
+    contentCondition.wait(lock, [&]() {
+        return length < loaded || readyState == UNSENT || COMPLETE <= readyState || (cancelled && *cancelled);
+    });
+}
+
+void HttpRequest::wakeUp()
+{
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+    }
+    contentCondition.notify_all();
+}
+
 void HttpRequest::setHandler(boost::function<void (void)> f)
 {
     handler = f;
@@ -130,9 +179,11 @@ bool HttpRequest::redirect(const HttpResponseMessage& res)
     // Redirect to location
     if (content.is_open())
         content.close();
+    releaseFile();
     filePath.clear();
+    loaded = 0;
     cache = 0;
-    readyState = OPENED;
+    setReadyState(OPENED);
     return true;
 }
 
@@ -144,14 +195,21 @@ bool HttpRequest::complete(bool error)
         response.getLastModifiedValue(lastModified);
     else
         response.setStatus(404);
-    readyState = (cache || handler || !callbackList.empty()) ? COMPLETE : DONE;
+    setReadyState((cache || handler || !callbackList.empty()) ? COMPLETE : DONE);
     return readyState == COMPLETE;
 }
 
 void HttpRequest::notify()
 {
-    if (cache)
+    if (cache) {
+        HttpCache* shared = cache;
         cache->notify(this, errorFlag);
+        // Upon success, the cache takes over the content file of this request.
+        if (!errorFlag && !(flags & CACHED) && !filePath.empty() && filePath == shared->getFilePath()) {
+            HttpCacheManager::getInstance().retainFile(filePath);
+            flags |= CACHED;
+        }
+    }
     if (!errorFlag && redirect(response)) {
         response.clear();
         send();
@@ -169,7 +227,7 @@ void HttpRequest::notify()
         }
     }
 
-    readyState = DONE;
+    setReadyState(DONE);
 }
 
 bool HttpRequest::notify(bool error)
@@ -183,7 +241,8 @@ void HttpRequest::open(const std::u16string& method, const std::u16string& urlSt
 {
     URL url(base, urlString);
     request.open(utfconv(method), url);
-    readyState = OPENED;
+    loaded = 0;
+    setReadyState(OPENED);
 }
 
 void HttpRequest::setRequestHeader(const std::u16string& header, const std::u16string& value)
@@ -194,7 +253,7 @@ void HttpRequest::setRequestHeader(const std::u16string& header, const std::u16s
 bool HttpRequest::constructResponseFromCache(bool sync)
 {
     assert(cache);
-    readyState = COMPLETE;
+    setReadyState(COMPLETE);
     errorFlag = false;
 
     response.update(cache->getResponseMessage());
@@ -202,7 +261,12 @@ bool HttpRequest::constructResponseFromCache(bool sync)
     response.getLastModifiedValue(lastModified);
 
     // TODO: deal with partial...
+    releaseFile();
     filePath = cache->getFilePath();
+    if (!filePath.empty()) {
+        HttpCacheManager::getInstance().retainFile(filePath);
+        flags |= CACHED;
+    }
 
     cache = 0;
     if (sync)
@@ -210,7 +274,7 @@ bool HttpRequest::constructResponseFromCache(bool sync)
     else
         HttpConnectionManager::getInstance().complete(self(), errorFlag);
 
-    readyState = DONE;
+    setReadyState(DONE);
 
     return errorFlag;
 }
@@ -348,12 +412,13 @@ void HttpRequest::abort(bool dtor)
         HttpConnectionManager& manager = HttpConnectionManager::getInstance();
         manager.abort(self());
     }
-    readyState = UNSENT;
+    setReadyState(UNSENT);
     errorFlag = false;
     request.clear();
     response.clear();
     if (content.is_open())
         content.close();
+    releaseFile();
     filePath.clear();   // TODO: Check if we should remove file now
     cache = 0;
 }
@@ -400,6 +465,7 @@ HttpRequest::HttpRequest(const std::u16string& base) :
     readyState(UNSENT),
     flags(DONT_REMOVE),
     errorFlag(false),
+    loaded(0),
     cache(0),
     handler(0),
     lastModified(0),
@@ -412,6 +478,7 @@ HttpRequest::~HttpRequest()
     if (!(flags & DONT_REMOVE))
         removeFile();
     abort(true);
+    releaseFile();
     delete boxImage;
 }
 
@@ -18,9 +18,11 @@
 #define ES_HTTP_REQUEST_H
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdio>
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <fstream>
 #include <boost/function.hpp>
 
@@ -54,13 +56,14 @@ public:
     // flags
     static const unsigned short DONT_REMOVE = 1;    // Do not remove filePath upon destruction
     static const unsigned short CANCELED = 2;
+    static const unsigned short CACHED = 4;         // filePath is the body file of the cache
 
 private:
     static std::string aboutPath;
     static std::string cachePath;
 
     std::u16string base;
-    unsigned short readyState;
+    std::atomic_ushort readyState;  // read by the threads waiting for the content
     std::atomic_ushort flags;
     bool errorFlag;
     HttpRequestMessage request;
@@ -68,6 +71,9 @@ private:
 
     std::string filePath;
     std::fstream content;
+    std::atomic_ullong loaded;  // the number of bytes written to content
+    std::mutex contentMutex;
+    std::condition_variable contentCondition;  // notified as the content arrives
 
     HttpCache* cache;
     boost::function<void (void)> handler;
@@ -77,6 +83,9 @@ private:
 
     BoxImage* boxImage;
 
+    void releaseFile();
+    void setReadyState(unsigned short state);
+
 public:
     HttpRequest(const std::u16string& base = u"");
     ~HttpRequest();
@@ -107,16 +116,29 @@ public:
         return filePath;
     }
     void removeFile() {
-        if (!filePath.empty()) {
+        if (flags & CACHED)
+            releaseFile();
+        else if (!filePath.empty())
             remove(filePath.c_str());
-            filePath.clear();
-        }
+        filePath.clear();
     }
 
     int getContentDescriptor();
     std::fstream& getContent();
     std::FILE* openFile();
 
+    // Called by HttpConnection each time a part of the content has been
+    // written to the content file.
+    void progress(unsigned long long length);
+    unsigned long long getLoadedBytes() const {
+        return loaded;
+    }
+    // Blocks the calling thread until more than length bytes of the content
+    // have been loaded, the request completes, or *cancelled becomes true.
+    void waitForContent(unsigned long long length, const std::atomic_bool* cancelled);
+    // Wakes up the threads blocked in waitForContent().
+    void wakeUp();
+
     void setHandler(boost::function<void (void)> f);
     void clearHandler();
     unsigned addCallback(boost::function<void (void)> f, unsigned id = static_cast<unsigned>(-1));
@@ -267,6 +267,38 @@ bool HttpResponseMessage::isChunked() const
     return hasToken(value, "chunked", 7);
 }
 
+bool HttpResponseMessage::isConnectionClose() const
+{
+    std::string value;
+    if (!headers.get("Connection", value))
+        return false;
+    return hasToken(value, "close", 5);
+}
+
+int HttpResponseMessage::getContentCoding() const
+{
+    std::string value;
+    if (!headers.get("Content-Encoding", value))
+        return IDENTITY;
+    trimLWS(value);
+    toLowerCase(value);
+    if (value.empty() || value == "identity")
+        return IDENTITY;
+    if (value == "gzip" || value == "x-gzip")
+        return GZIP;
+    if (value == "deflate")
+        return DEFLATE;
+    return UNKNOWN_CODING;
+}
+
+void HttpResponseMessage::clearContentCoding()
+{
+    headers.erase("Content-Encoding");
+    headers.erase("Content-Length");
+    hasContentLength = false;
+    contentLength = 0;
+}
+
 bool HttpResponseMessage::getExpiresValue(long long& expiresValue) const
 {
     std::string value;
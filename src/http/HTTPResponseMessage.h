@@ -47,6 +47,14 @@ class HttpResponseMessage
     bool parseHeader(const HttpHeader& hdr);
 
 public:
+    // content codings
+    enum {
+        IDENTITY,
+        GZIP,
+        DEFLATE,
+        UNKNOWN_CODING
+    };
+
     HttpResponseMessage();
 
     const char* parseMediaType(const char* start, const char* const end);
@@ -126,6 +134,11 @@ public:
     bool isFresh(long long requestTime) const;
 
     bool isChunked() const;
+    bool isConnectionClose() const;
+
+    int getContentCoding() const;
+    // Removes Content-Encoding and Content-Length after the content has been decoded.
+    void clearContentCoding();
 
     void clear();
     void update(const HttpResponseMessage& response);